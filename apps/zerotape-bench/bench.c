@@ -0,0 +1,108 @@
+/* bench.c */
+
+/* Parse timing for large generated inputs. Each run doubles the number of
+ * top-level assignments, so if parsing is linear the time per assignment
+ * ought to stay roughly level. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "fortify/fortify.h"
+
+#include "zerotape/zerotape.h"
+
+/* ----------------------------------------------------------------------- */
+
+#define MINASSIGNMENTS (125000)
+#define MAXASSIGNMENTS (1000000)
+
+/* ----------------------------------------------------------------------- */
+
+/* Returns a program of 'n' top-level assignments, or NULL if out of
+ * memory. */
+static char *make_program(long n, size_t *length)
+{
+  char  *program;
+  char  *p;
+  long   i;
+
+  program = malloc(n * 32);
+  if (program == NULL)
+    return NULL;
+
+  p = program;
+  for (i = 0; i < n; i++)
+    p += sprintf(p, "field%ld = %ld;\n", i, i * 7);
+
+  *length = p - program;
+  return program;
+}
+
+static ztresult_t bench_parse(long n, double *seconds)
+{
+  ztresult_t  rc;
+  char       *program;
+  size_t      length;
+  clock_t     start;
+  ztparser_t *parser;
+
+  program = make_program(n, &length);
+  if (program == NULL)
+    return ztresult_OOM;
+
+  start = clock();
+
+  parser = ztparser_create();
+  if (parser == NULL)
+  {
+    free(program);
+    return ztresult_OOM;
+  }
+
+  rc = ztparser_feed(parser, program, length);
+
+  *seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+  /* only the parse is timed, so the result is discarded unloaded */
+  ztparser_destroy(parser);
+  free(program);
+
+  if (rc)
+    fprintf(stderr, "parse error\n");
+
+  return rc;
+}
+
+/* ----------------------------------------------------------------------- */
+
+int main(void)
+{
+  ztresult_t rc = ztresult_OK;
+  long       n;
+  double     seconds;
+
+  (void) Fortify_EnterScope();
+
+  printf("%10s %10s %12s\n", "assigns", "seconds", "ns/assign");
+
+  for (n = MINASSIGNMENTS; n <= MAXASSIGNMENTS; n *= 2)
+  {
+    rc = bench_parse(n, &seconds);
+    if (rc)
+    {
+      fprintf(stderr, "bench_parse() returned error %x\n", rc);
+      break;
+    }
+
+    printf("%10ld %10.3f %12.1f\n", n, seconds, seconds * 1e9 / n);
+  }
+
+  (void) Fortify_LeaveScope();
+
+  return (rc == ztresult_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* ----------------------------------------------------------------------- */
+
+/* vim: set ts=8 sts=2 sw=2 et: */
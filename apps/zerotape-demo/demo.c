@@ -192,6 +192,51 @@ static ztresult_t bandmember_loader(const ztast_expr_t *expr,
   return ztresult_OK;
 }
 
+/* Set up the example structure layout (but not the values themselves),
+ * scribbling over the values so that a load which misses any shows up. */
+static void reset_example(example_t *example, sub_t *sub)
+{
+  memset(example, 0x55, sizeof(*example));
+  example->pointer_to_integer = &pointed_at;
+  example->pointer_to_sub     = sub;
+}
+
+/* Report a failed load, freeing its syntax error message if it has one. */
+static void report_failure(const char *name,
+                           ztresult_t  rc,
+                           char       *syntax_error)
+{
+  fprintf(stderr, "%s failed (%d)\n", name, rc);
+  if (syntax_error)
+  {
+    fprintf(stderr, "syntax error: %s\n", syntax_error);
+    zt_freesyntax(syntax_error);
+  }
+}
+
+/* Check that 'example' holds the values saved by main(). */
+static void check_example(const example_t *example, const char *tenbyte)
+{
+  assert(example->integer == 42);
+  assert(pointed_at == 33);
+  assert(example->integer_array[0] == 61);
+  assert(example->integer_array[1] == 62);
+  assert(example->integer_array[2] == 63);
+  assert(example->inline_sub.value == 43);
+  assert(example->pointer_to_sub->value == 51);
+  assert(example->array_of_sub[0].value == 44);
+  assert(example->array_of_sub[1].value == 45);
+  assert(example->array_of_sub[2].value == 46);
+  assert(example->static_pointer == &example_array[2]);
+  assert(example->static_nullpointer == NULL);
+  assert(example->pointer == &tenbyte[5]);
+  assert(example->nullpointer == NULL);
+  assert(example->string_in_array == popular_beat_combo[3]);
+
+  (void) example; /* the asserts may be compiled out */
+  (void) tenbyte;
+}
+
 /* ----------------------------------------------------------------------- */
 
 int main(void)
@@ -202,14 +247,24 @@ int main(void)
   static const char testfile[] = "demo.zt";
 #endif
 
-  ztresult_t  rc;
-  char       *tenbyte;
-  example_t   example;
-  ztregion_t  regions[1]; /* descriptions of heap blocks */
-  sub_t       sub;
-  ztsaver_t  *savers[1];
-  ztloader_t *loaders[1];
-  char       *syntax_error;
+  ztresult_t   rc;
+  char        *tenbyte;
+  example_t    example;
+  ztregion_t   regions[1]; /* descriptions of heap blocks */
+  sub_t        sub;
+  ztsaver_t   *savers[1];
+  ztloader_t  *loaders[1];
+  char        *syntax_error;
+  FILE        *f;
+  ztparser_t  *parser;
+  char         chunk[16];
+  size_t       n;
+  zt_loader_t *loader;
+  int          i;
+  char        *buffer;
+  size_t       length;
+  char        *saved;
+  size_t       measured;
 
   tenbyte = malloc(10);
   if (tenbyte == NULL)
@@ -252,10 +307,15 @@ int main(void)
     return EXIT_FAILURE;
   }
 
-  /* Setup the example structure layout (but not the values themselves) */
-  memset(&example, 0x55, sizeof(example_t));
-  example.pointer_to_integer    = &pointed_at;
-  example.pointer_to_sub        = &sub;
+  /* Build the field lookup indexes up front (optional) */
+  rc = zt_prepare(&example_meta);
+  if (rc != ztresult_OK)
+  {
+    fprintf(stderr, "zt_prepare failed (%d)\n", rc);
+    return EXIT_FAILURE;
+  }
+
+  reset_example(&example, &sub);
 
   loaders[CUSTOMTYPE_BAND_MEMBER] = bandmember_loader;
   rc = zt_load(&example_meta,
@@ -268,30 +328,219 @@ int main(void)
                &syntax_error);
   if (rc != ztresult_OK)
   {
-    fprintf(stderr, "zt_load failed (%d)\n", rc);
-    if (syntax_error)
+    report_failure("zt_load", rc, syntax_error);
+    return EXIT_FAILURE;
+  }
+
+  check_example(&example, tenbyte);
+
+  /* Load it again, this time feeding the parser the data in small chunks as
+   * if it were arriving over a pipe */
+  reset_example(&example, &sub);
+
+  f = fopen(testfile, "rb");
+  if (f == NULL)
+    return EXIT_FAILURE;
+
+  parser = ztparser_create();
+  if (parser == NULL)
+    return EXIT_FAILURE;
+
+  while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+    if (ztparser_feed(parser, chunk, n) != ztresult_OK)
+      break; /* ztparser_finish will report the error */
+
+  fclose(f);
+
+  rc = ztparser_finish(parser,
+                      &example_meta,
+                      &example,
+                      &regions[0],
+                       NELEMS(regions),
+                       loaders,
+                       NELEMS(loaders),
+                      &syntax_error);
+  if (rc != ztresult_OK)
+  {
+    report_failure("ztparser_finish", rc, syntax_error);
+    return EXIT_FAILURE;
+  }
+
+  check_example(&example, tenbyte);
+
+  /* Load it a few more times through a load context, as a program loading
+   * many files would */
+  loader = zt_loader_create();
+  if (loader == NULL)
+    return EXIT_FAILURE;
+
+  for (i = 0; i < 3; i++)
+  {
+    reset_example(&example, &sub);
+
+    rc = zt_loader_load(loader,
+                       &example_meta,
+                       &example,
+                        testfile,
+                       &regions[0],
+                        NELEMS(regions),
+                        loaders,
+                        NELEMS(loaders),
+                       &syntax_error);
+    if (rc != ztresult_OK)
     {
-      fprintf(stderr, "syntax error: %s\n", syntax_error);
-      zt_freesyntax(syntax_error);
+      report_failure("zt_loader_load", rc, syntax_error);
+      zt_loader_destroy(loader);
+      return EXIT_FAILURE;
     }
+
+    check_example(&example, tenbyte);
+  }
+
+  zt_loader_destroy(loader);
+
+  /* Load it once more as a stream, storing values as they're parsed */
+  reset_example(&example, &sub);
+
+  rc = zt_load_streaming(&example_meta,
+                         &example,
+                          testfile,
+                         &regions[0],
+                          NELEMS(regions),
+                          loaders,
+                          NELEMS(loaders),
+                         &syntax_error);
+  if (rc != ztresult_OK)
+  {
+    report_failure("zt_load_streaming", rc, syntax_error);
     return EXIT_FAILURE;
   }
 
-  assert(example.integer == 42);
-  assert(pointed_at == 33);
-  assert(example.integer_array[0] == 61);
-  assert(example.integer_array[1] == 62);
-  assert(example.integer_array[2] == 63);
-  assert(example.inline_sub.value == 43);
-  assert(example.pointer_to_sub->value == 51);
-  assert(example.array_of_sub[0].value == 44);
-  assert(example.array_of_sub[1].value == 45);
-  assert(example.array_of_sub[2].value == 46);
-  assert(example.static_pointer == &example_array[2]);
-  assert(example.static_nullpointer == NULL);
-  assert(example.pointer == &tenbyte[5]);
-  assert(example.nullpointer == NULL);
-  assert(example.string_in_array == popular_beat_combo[3]);
+  check_example(&example, tenbyte);
+
+  /* Save it into memory, which should give the same text as the file */
+  rc = zt_save_to_buffer(&example_meta,
+                         &example,
+                         &buffer,
+                         &length,
+                         &regions[0],
+                          NELEMS(regions),
+                          savers,
+                          NELEMS(savers),
+                          0);
+  if (rc != ztresult_OK)
+  {
+    fprintf(stderr, "zt_save_to_buffer failed (%d)\n", rc);
+    return EXIT_FAILURE;
+  }
+
+  /* Measuring should give the exact length of the text */
+  rc = zt_save_measure(&example_meta,
+                       &example,
+                       &measured,
+                       &regions[0],
+                        NELEMS(regions),
+                        savers,
+                        NELEMS(savers),
+                        0);
+  if (rc != ztresult_OK || measured != length)
+  {
+    fprintf(stderr, "zt_save_measure failed (%d)\n", rc);
+    return EXIT_FAILURE;
+  }
+
+  saved = malloc(length + 1);
+  if (saved == NULL)
+    return EXIT_FAILURE;
+
+  f = fopen(testfile, "rb");
+  if (f == NULL)
+    return EXIT_FAILURE;
+  n = fread(saved, 1, length + 1, f); /* one more to detect a longer file */
+  fclose(f);
+
+  if (n != length || memcmp(saved, buffer, length) != 0)
+  {
+    fprintf(stderr, "zt_save_to_buffer output differs from zt_save's\n");
+    return EXIT_FAILURE;
+  }
+
+  free(saved);
+
+  /* Load it back from memory */
+  reset_example(&example, &sub);
+
+  rc = zt_load_from_buffer(&example_meta,
+                           &example,
+                            buffer,
+                            length,
+                           &regions[0],
+                            NELEMS(regions),
+                            loaders,
+                            NELEMS(loaders),
+                           &syntax_error);
+  if (rc != ztresult_OK)
+  {
+    report_failure("zt_load_from_buffer", rc, syntax_error);
+    return EXIT_FAILURE;
+  }
+
+  check_example(&example, tenbyte);
+
+  free(buffer);
+
+  /* Save it into memory compactly, then load it back */
+  rc = zt_save_to_buffer(&example_meta,
+                         &example,
+                         &buffer,
+                         &length,
+                         &regions[0],
+                          NELEMS(regions),
+                          savers,
+                          NELEMS(savers),
+                          ztsaveflag_COMPACT);
+  if (rc != ztresult_OK)
+  {
+    fprintf(stderr, "zt_save_to_buffer failed (%d)\n", rc);
+    return EXIT_FAILURE;
+  }
+
+  rc = zt_save_measure(&example_meta,
+                       &example,
+                       &measured,
+                       &regions[0],
+                        NELEMS(regions),
+                        savers,
+                        NELEMS(savers),
+                        ztsaveflag_COMPACT);
+  if (rc != ztresult_OK || measured != length)
+  {
+    fprintf(stderr, "zt_save_measure failed (%d)\n", rc);
+    return EXIT_FAILURE;
+  }
+
+  reset_example(&example, &sub);
+
+  rc = zt_load_from_buffer(&example_meta,
+                           &example,
+                            buffer,
+                            length,
+                           &regions[0],
+                            NELEMS(regions),
+                            loaders,
+                            NELEMS(loaders),
+                           &syntax_error);
+  if (rc != ztresult_OK)
+  {
+    report_failure("zt_load_from_buffer", rc, syntax_error);
+    return EXIT_FAILURE;
+  }
+
+  check_example(&example, tenbyte);
+
+  free(buffer);
+
+  zt_release_prepared();
 
   return EXIT_SUCCESS;
 }
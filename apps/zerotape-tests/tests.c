@@ -1,6 +1,7 @@
 /* tests.c */
 
 #include <stdio.h>
+#include <string.h>
 
 #include "fortify/fortify.h"
 
@@ -34,6 +35,452 @@ static ztresult_t parse_and_dump_dot(const char *filename,
   return rc;
 }
 
+/* Returns non-zero if ASTs 'a' and 'b' hold the same program. */
+static int same_ast(const ztast_t *a, const ztast_t *b)
+{
+  return a->nnodes   == b->nnodes &&
+         a->nints    == b->nints &&
+         a->nstrings == b->nstrings &&
+         memcmp(a->ints, b->ints, a->nints * sizeof(*a->ints)) == 0 &&
+         /* string offset zero is reserved, and its byte is never set */
+         memcmp(a->strings + 1, b->strings + 1, a->nstrings - 1) == 0;
+}
+
+/* Parse a file by feeding it to an incremental parser 'chunksz' bytes at a
+ * time, so that tokens get split across chunks, and check that the result
+ * matches parsing it whole. */
+static ztresult_t parse_in_chunks(const char *filename, size_t chunksz)
+{
+  ztresult_t  rc = ztresult_OK;
+  char        errbuf[ZTMAXERRBUF];
+  FILE       *f;
+  ztparser_t *parser;
+  char        chunk[256];
+  size_t      n;
+  ztast_t    *ast;
+  ztast_t    *whole;
+
+  if (chunksz > sizeof(chunk))
+    chunksz = sizeof(chunk);
+
+  f = fopen(filename, "rb");
+  if (f == NULL)
+    return ztresult_BAD_FOPEN;
+
+  parser = ztparser_create();
+  if (parser == NULL)
+  {
+    fclose(f);
+    return ztresult_OOM;
+  }
+
+  while ((n = fread(chunk, 1, chunksz, f)) > 0)
+    if (ztparser_feed(parser, chunk, n) != ztresult_OK)
+      break; /* ztast_from_parser reports the error */
+
+  fclose(f);
+
+  ast = ztast_from_parser(parser, errbuf);
+  if (ast == NULL)
+  {
+    fprintf(stderr, "parse error: %s\n", errbuf);
+    return ztresult_NO_PROGRAM;
+  }
+
+  whole = ztast_from_file(filename, errbuf);
+  if (whole == NULL)
+  {
+    fprintf(stderr, "parse error: %s\n", errbuf);
+    rc = ztresult_NO_PROGRAM;
+  }
+  else if (!same_ast(ast, whole))
+  {
+    fprintf(stderr, "parsing in chunks gave a different AST\n");
+    rc = ztresult_NO_PROGRAM;
+  }
+
+  ztast_destroy(whole);
+  ztast_destroy(ast);
+
+  return rc;
+}
+
+/* Parse a file 'n' times using a single reusable parser. */
+static ztresult_t parse_repeatedly(const char *filename, int n)
+{
+  ztresult_t  rc = ztresult_OK;
+  char        errbuf[ZTMAXERRBUF];
+  ztparser_t *parser;
+  int         i;
+
+  parser = ztparser_create_reusable();
+  if (parser == NULL)
+    return ztresult_OOM;
+
+  for (i = 0; i < n; i++)
+  {
+    /* each AST is freed by the next parse */
+    if (ztparser_parse_file(parser, filename, errbuf) == NULL)
+    {
+      fprintf(stderr, "parse error: %s\n", errbuf);
+      rc = ztresult_NO_PROGRAM;
+      break;
+    }
+  }
+
+  ztparser_delete(parser);
+
+  return rc;
+}
+
+/* ----------------------------------------------------------------------- */
+
+/* Loads are checked against this small structure. */
+typedef struct loadtest
+{
+  ztuint_t    a;
+  ztuint_t    b;
+  const char *c;
+}
+loadtest_t;
+
+static const ztfield_t loadtest_fields[] =
+{
+  ZTUINT(a, loadtest_t),
+  ZTUINT(b, loadtest_t),
+  ZTCUSTOM(c, loadtest_t, 0)
+};
+
+static const ztstruct_t loadtest_meta =
+{
+  NELEMS(loadtest_fields),
+  loadtest_fields
+};
+
+#ifdef __riscos
+static const char loadtest_file[] = "loadtest_zt";
+#else
+static const char loadtest_file[] = "loadtest.zt";
+#endif
+
+/* A custom loader which fails without giving a message. */
+static ztresult_t silently_failing_loader(const ztast_expr_t *expr,
+                                          void               *pvalue,
+                                          char               *errbuf)
+{
+  (void) expr;
+  (void) pvalue;
+  (void) errbuf;
+
+  return ztresult_BAD_CUSTOMID;
+}
+
+static ztresult_t write_loadtest(const char *text)
+{
+  FILE *f;
+
+  f = fopen(loadtest_file, "wb");
+  if (f == NULL)
+    return ztresult_BAD_FOPEN;
+
+  fputs(text, f);
+
+  return (fclose(f) == 0) ? ztresult_OK : ztresult_BAD_WRITE;
+}
+
+/* Returns ztresult_OK if the load named 'name' failed with the loader's
+ * error. */
+static ztresult_t expect_loader_error(const char *name,
+                                      ztresult_t  rc,
+                                      char       *syntax_error)
+{
+  zt_freesyntax(syntax_error);
+  if (rc == ztresult_BAD_CUSTOMID)
+    return ztresult_OK;
+
+  fprintf(stderr, "%s returned %x rather than the loader's error\n", name, rc);
+  return rc ? rc : ztresult_SYNTAX_ERROR;
+}
+
+/* A custom loader's error must fail the load even when it leaves no
+ * message, however the file is loaded. */
+static ztresult_t load_with_failing_loader(void)
+{
+  ztresult_t  rc;
+  ztloader_t *loaders[1];
+  loadtest_t  loadtest;
+  char       *syntax_error;
+
+  rc = write_loadtest("a = 1; c = 5; b = 7;\n");
+  if (rc)
+    return rc;
+
+  loaders[0] = silently_failing_loader;
+
+  rc = zt_load(&loadtest_meta,
+               &loadtest,
+                loadtest_file,
+                NULL,
+                0,
+                loaders,
+                NELEMS(loaders),
+               &syntax_error);
+  rc = expect_loader_error("zt_load", rc, syntax_error);
+  if (rc)
+    return rc;
+
+  rc = zt_load_streaming(&loadtest_meta,
+                         &loadtest,
+                          loadtest_file,
+                          NULL,
+                          0,
+                          loaders,
+                          NELEMS(loaders),
+                         &syntax_error);
+  rc = expect_loader_error("zt_load_streaming", rc, syntax_error);
+  if (rc)
+    return rc;
+
+  remove(loadtest_file);
+
+  return ztresult_OK;
+}
+
+/* Load 'text' through 'loader' and check its counts. */
+static ztresult_t load_and_count(zt_loader_t   *loader,
+                                 const char    *text,
+                                 unsigned long  predicted,
+                                 unsigned long  searched)
+{
+  ztresult_t     rc;
+  loadtest_t     loadtest;
+  char          *syntax_error;
+  ztloadstats_t  stats;
+
+  rc = write_loadtest(text);
+  if (rc)
+    return rc;
+
+  rc = zt_loader_load(loader,
+                      &loadtest_meta,
+                      &loadtest,
+                       loadtest_file,
+                       NULL,
+                       0,
+                       NULL,
+                       0,
+                      &syntax_error);
+  zt_freesyntax(syntax_error);
+  if (rc)
+    return rc;
+
+  zt_loader_stats(loader, &stats);
+  if (stats.predicted != predicted || stats.searched != searched)
+  {
+    fprintf(stderr, "'%s' counted %lu predicted, %lu searched\n",
+            text, stats.predicted, stats.searched);
+    return ztresult_BAD_FIELD;
+  }
+
+  return ztresult_OK;
+}
+
+/* Fields assigned in order should be predicted; others searched for. */
+static ztresult_t count_predictions(void)
+{
+  ztresult_t   rc;
+  zt_loader_t *loader;
+
+  loader = zt_loader_create();
+  if (loader == NULL)
+    return ztresult_OOM;
+
+  rc = load_and_count(loader, "a = 1; b = 2;\n", 2, 0);
+  if (rc == ztresult_OK)
+    rc = load_and_count(loader, "b = 2; a = 1;\n", 0, 2);
+
+  zt_loader_destroy(loader);
+
+  remove(loadtest_file);
+
+  return rc;
+}
+
+/* Load 'text' by feeding it to an incremental parser a byte at a time, and
+ * check that the result matches zt_load's, which should be 'wantrc'. */
+static ztresult_t load_in_chunks(const char *text, ztresult_t wantrc)
+{
+  ztresult_t  rc;
+  ztresult_t  expected;
+  loadtest_t  want;
+  loadtest_t  got;
+  char       *syntax_error;
+  ztparser_t *parser;
+  size_t      i;
+
+  rc = write_loadtest(text);
+  if (rc)
+    return rc;
+
+  memset(&want, 0, sizeof(want));
+  expected = zt_load(&loadtest_meta,
+                     &want,
+                      loadtest_file,
+                      NULL,
+                      0,
+                      NULL,
+                      0,
+                     &syntax_error);
+  zt_freesyntax(syntax_error);
+
+  parser = ztparser_create();
+  if (parser == NULL)
+    return ztresult_OOM;
+
+  for (i = 0; text[i] != '\0'; i++)
+    if (ztparser_feed(parser, &text[i], 1) != ztresult_OK)
+      break; /* ztparser_finish reports the error */
+
+  memset(&got, 0, sizeof(got));
+  rc = ztparser_finish(parser,
+                       &loadtest_meta,
+                       &got,
+                        NULL,
+                        0,
+                        NULL,
+                        0,
+                       &syntax_error);
+  zt_freesyntax(syntax_error);
+
+  if (rc != wantrc || expected != wantrc ||
+      (rc == ztresult_OK && (got.a != want.a || got.b != want.b)))
+  {
+    fprintf(stderr, "'%s' loaded in chunks gave %x, zt_load gave %x\n",
+            text, rc, expected);
+    return ztresult_BAD_FIELD;
+  }
+
+  return ztresult_OK;
+}
+
+/* Chunked loads must flush the last token and catch errors which only show
+ * at the end of the input. Abandoning a parser mustn't leak. */
+static ztresult_t load_in_chunks_tests(void)
+{
+  static const char abandoned[] = "a = 1; b =";
+
+  ztresult_t  rc;
+  ztparser_t *parser;
+
+  rc = load_in_chunks("a = 1; b = 23;", ztresult_OK);
+  if (rc == ztresult_OK)
+    rc = load_in_chunks("a = 1; b = 23", ztresult_PARSE_FAIL);
+  if (rc == ztresult_OK)
+    rc = load_in_chunks("a = 1; b = 2 +", ztresult_PARSE_FAIL);
+
+  remove(loadtest_file);
+
+  if (rc)
+    return rc;
+
+  parser = ztparser_create();
+  if (parser == NULL)
+    return ztresult_OOM;
+
+  rc = ztparser_feed(parser, abandoned, sizeof(abandoned) - 1);
+  ztparser_destroy(parser);
+
+  return rc;
+}
+
+/* A linked list, to nest a file as deeply as we like. */
+typedef struct chain
+{
+  ztuint_t      value;
+  struct chain *next;
+}
+chain_t;
+
+static const ztstruct_t chain_meta;
+
+static const ztfield_t chain_fields[] =
+{
+  ZTUINT(value, chain_t),
+  ZTSTRUCTPTR(next, chain_t, chain_t, &chain_meta)
+};
+
+static const ztstruct_t chain_meta =
+{
+  NELEMS(chain_fields),
+  chain_fields
+};
+
+/* Nearly as deep as the parser's stack allows, and deeper than a streaming
+ * load's initial frame stack. */
+#define CHAINLENGTH (24)
+
+/* Load a file nesting CHAINLENGTH deep, both whole and streaming. */
+static ztresult_t load_deeply_nested(void)
+{
+  static chain_t chain[CHAINLENGTH];
+  static char    text[CHAINLENGTH * 32];
+
+  ztresult_t  rc;
+  char       *p;
+  int         i;
+  int         streaming;
+  char       *syntax_error;
+
+  p = text;
+  for (i = 0; i < CHAINLENGTH; i++)
+  {
+    chain[i].next = (i + 1 < CHAINLENGTH) ? &chain[i + 1] : NULL;
+    p += sprintf(p, "value = %d;%s", i, chain[i].next ? " next = {" : "");
+  }
+  for (i = 1; i < CHAINLENGTH; i++)
+    p += sprintf(p, " };");
+
+  rc = write_loadtest(text);
+  if (rc)
+    return rc;
+
+  for (streaming = 0; streaming < 2 && rc == ztresult_OK; streaming++)
+  {
+    for (i = 0; i < CHAINLENGTH; i++)
+      chain[i].value = 0;
+
+    if (streaming)
+      rc = zt_load_streaming(&chain_meta,
+                             &chain[0],
+                              loadtest_file,
+                              NULL,
+                              0,
+                              NULL,
+                              0,
+                             &syntax_error);
+    else
+      rc = zt_load(&chain_meta,
+                   &chain[0],
+                    loadtest_file,
+                    NULL,
+                    0,
+                    NULL,
+                    0,
+                   &syntax_error);
+    zt_freesyntax(syntax_error);
+
+    for (i = 0; i < CHAINLENGTH && rc == ztresult_OK; i++)
+      if (chain[i].value != (ztuint_t) i)
+        rc = ztresult_BAD_FIELD;
+  }
+
+  remove(loadtest_file);
+
+  return rc;
+}
+
+/* ----------------------------------------------------------------------- */
+
 int main(int argc, char *argv[])
 {
   ztresult_t rc = ztresult_OK;
@@ -55,14 +502,68 @@ int main(int argc, char *argv[])
   ztlex_stringtest("nil");
   ztlex_stringtest("1nil2");
   ztlex_stringtest(" 1 nil 2 ");
+  ztlex_stringtest("a = [ 1, $2, 0x3,\n 4 ];");
+  ztlex_stringtest("a = [ 1, 2 + 3, 4, 5 * 6 ];");
+  ztlex_stringtest("a = [ { b = [ 1 ]; }, { c = 2; } ];");
 
-  if (argc > 1)
+  rc = load_with_failing_loader();
+  if (rc != ztresult_OK)
+    fprintf(stderr, "load_with_failing_loader() returned error %x\n", rc);
+  else
+    printf("failing loader reported\n");
+
+  if (rc == ztresult_OK)
+  {
+    rc = count_predictions();
+    if (rc != ztresult_OK)
+      fprintf(stderr, "count_predictions() returned error %x\n", rc);
+    else
+      printf("predictions counted\n");
+  }
+
+  if (rc == ztresult_OK)
+  {
+    rc = load_in_chunks_tests();
+    if (rc != ztresult_OK)
+      fprintf(stderr, "load_in_chunks_tests() returned error %x\n", rc);
+    else
+      printf("loaded in chunks\n");
+  }
+
+  if (rc == ztresult_OK)
+  {
+    rc = load_deeply_nested();
+    if (rc != ztresult_OK)
+      fprintf(stderr, "load_deeply_nested() returned error %x\n", rc);
+    else
+      printf("loaded deeply nested\n");
+  }
+
+  if (rc == ztresult_OK && argc > 1)
   {
     rc = parse_and_dump_dot(argv[1], "ztast.dot");
     if (rc != ztresult_OK)
       fprintf(stderr, "parse_and_dump_dot() returned error %x\n", rc);
     else
       printf("ztast.dot created\n");
+
+    if (rc == ztresult_OK)
+    {
+      rc = parse_in_chunks(argv[1], 1);
+      if (rc != ztresult_OK)
+        fprintf(stderr, "parse_in_chunks() returned error %x\n", rc);
+      else
+        printf("parsed in 1-byte chunks\n");
+    }
+
+    if (rc == ztresult_OK)
+    {
+      rc = parse_repeatedly(argv[1], 3);
+      if (rc != ztresult_OK)
+        fprintf(stderr, "parse_repeatedly() returned error %x\n", rc);
+      else
+        printf("parsed repeatedly\n");
+    }
   }
 
   (void) Fortify_LeaveScope();
@@ -40,6 +40,7 @@ typedef int ztresult_t;
 #define ztresult_BAD_POINTER    ((ztresult_t) 0x80)
 #define ztresult_BAD_FIELD      ((ztresult_t) 0x90)
 #define ztresult_BAD_CUSTOMID   ((ztresult_t) 0xA0)
+#define ztresult_BAD_WRITE      ((ztresult_t) 0xB0)
 
 /* ----------------------------------------------------------------------- */
 
@@ -287,6 +288,16 @@ ztregion_t;
  * representation of it into buf. */
 typedef ztresult_t (ztsaver_t)(const void *pvalue, char *buf, size_t bufsz);
 
+/** A function which receives the next n bytes of saved output. Returning
+ * anything other than ztresult_OK abandons the save. */
+typedef ztresult_t (ztsink_t)(const void *bytes, size_t n, void *opaque);
+
+/** Options for zt_save_to_buffer, zt_save_to_sink and zt_save_measure. */
+typedef unsigned int ztsaveflags_t;
+
+/** Save with no indentation or line breaks - the minimum of whitespace. */
+#define ztsaveflag_COMPACT ((ztsaveflags_t) 1 << 0)
+
 /** A function which interprets the AST expression at expr and writes its value
  * to pvalue. */
 typedef ztresult_t (ztloader_t)(const ztast_expr_t *expr,
@@ -454,6 +465,55 @@ ztresult_t zt_load(const ztstruct_t  *meta,
                    int                nloaders,
                    char             **syntax_error);
 
+/**
+ * Load, as zt_load does, from text in memory.
+ *
+ * The text is parsed in place, not copied, and need not be terminated.
+ *
+ * \param meta description of 'structure'
+ * \param structure structure to load
+ * \param data text to load from
+ * \param length length of 'data' in bytes
+ * \param regions runtime heap array specs
+ * \param nregions number of heap array specs
+ * \param loaders array of loader functions - one per custom ID
+ * \param nloaders number of loader functions
+ * \param syntax_error syntax error message(s) - dispose using zt_freesyntax()
+ */
+ztresult_t zt_load_from_buffer(const ztstruct_t  *meta,
+                               void              *structure,
+                               const char        *data,
+                               size_t             length,
+                               const ztregion_t  *regions,
+                               int                nregions,
+                               ztloader_t       **loaders,
+                               int                nloaders,
+                               char             **syntax_error);
+
+/**
+ * Load, as zt_load does, but without building the whole file in memory
+ * first. Values are stored into 'structure' as they're parsed, so memory
+ * use depends only on how deeply the file nests. If loading fails part way
+ * through then 'structure' is left partially loaded.
+ *
+ * \param meta description of 'structure'
+ * \param structure structure to load
+ * \param filename filename to load from
+ * \param regions runtime heap array specs
+ * \param nregions number of heap array specs
+ * \param loaders array of loader functions - one per custom ID
+ * \param nloaders number of loader functions
+ * \param syntax_error syntax error message(s) - dispose using zt_freesyntax()
+ */
+ztresult_t zt_load_streaming(const ztstruct_t  *meta,
+                             void              *structure,
+                             const char        *filename,
+                             const ztregion_t  *regions,
+                             int                nregions,
+                             ztloader_t       **loaders,
+                             int                nloaders,
+                             char             **syntax_error);
+
 /**
  * Dispose of a syntax error.
  *
@@ -463,6 +523,141 @@ void zt_freesyntax(char *syntax_error);
 
 /* ----------------------------------------------------------------------- */
 
+/** A load context, reused across many loads. */
+typedef struct zt_loader zt_loader_t;
+
+/** Counts from a load. */
+typedef struct ztloadstats
+{
+  unsigned long predicted; /**< fields found by trying the one after the
+                                last field assigned in the same scope */
+  unsigned long searched;  /**< fields which had to be looked up - files
+                                not in zt_save's field order raise this */
+}
+ztloadstats_t;
+
+/**
+ * Create a load context. The context keeps its parser, memory arena and
+ * input buffers between loads, so that loading many small files costs
+ * little more than parsing them.
+ *
+ * \return new load context, or NULL if out of memory
+ */
+zt_loader_t *zt_loader_create(void);
+
+/**
+ * Load, as zt_load does, using a load context.
+ *
+ * \param loader load context
+ * \param meta description of 'structure'
+ * \param structure structure to load
+ * \param filename filename to load from
+ * \param regions runtime heap array specs
+ * \param nregions number of heap array specs
+ * \param loaders array of loader functions - one per custom ID
+ * \param nloaders number of loader functions
+ * \param syntax_error syntax error message(s) - dispose using zt_freesyntax()
+ */
+ztresult_t zt_loader_load(zt_loader_t       *loader,
+                          const ztstruct_t  *meta,
+                          void              *structure,
+                          const char        *filename,
+                          const ztregion_t  *regions,
+                          int                nregions,
+                          ztloader_t       **loaders,
+                          int                nloaders,
+                          char             **syntax_error);
+
+/**
+ * Retrieve the counts from a load context's most recent load.
+ *
+ * \param loader load context
+ * \param stats updated with the counts - zero if the file failed to parse
+ */
+void zt_loader_stats(const zt_loader_t *loader, ztloadstats_t *stats);
+
+/**
+ * Destroy a load context.
+ *
+ * \param loader load context to destroy - may be NULL
+ */
+void zt_loader_destroy(zt_loader_t *loader);
+
+/* ----------------------------------------------------------------------- */
+
+/**
+ * Build the field lookup indexes for 'meta', and for every structure it
+ * contains or points to, ahead of time. Loads build any index they need
+ * on first use, so calling this is optional. Preparing at startup moves
+ * that cost out of the first load and lets later loads run without
+ * modifying shared state.
+ *
+ * \param meta description of a structure
+ *
+ * \return ztresult_OOM if out of memory
+ */
+ztresult_t zt_prepare(const ztstruct_t *meta);
+
+/**
+ * Discard all field lookup indexes, whether built by zt_prepare or by
+ * loads. Call this before releasing any metadata which has been loaded.
+ */
+void zt_release_prepared(void);
+
+/* ----------------------------------------------------------------------- */
+
+/** An incremental parser, fed its input in chunks. */
+typedef struct ztparser ztparser_t;
+
+/**
+ * Create an incremental parser.
+ *
+ * \return new parser, or NULL if out of memory
+ */
+ztparser_t *ztparser_create(void);
+
+/**
+ * Parse the next chunk of input. Tokens may be split across chunks.
+ *
+ * \param ctx parser
+ * \param bytes chunk of input
+ * \param n length of chunk in bytes
+ * \return ztresult_PARSE_FAIL if a syntax error has been found - ztparser_finish returns the message
+ */
+ztresult_t ztparser_feed(ztparser_t *ctx, const void *bytes, size_t n);
+
+/**
+ * End the input, then load what was parsed as zt_load would. This destroys
+ * the parser.
+ *
+ * \param ctx parser
+ * \param meta description of 'structure'
+ * \param structure structure to load
+ * \param regions runtime heap array specs
+ * \param nregions number of heap array specs
+ * \param loaders array of loader functions - one per custom ID
+ * \param nloaders number of loader functions
+ * \param syntax_error syntax error message(s) - dispose using zt_freesyntax()
+ */
+ztresult_t ztparser_finish(ztparser_t        *ctx,
+                           const ztstruct_t  *meta,
+                           void              *structure,
+                           const ztregion_t  *regions,
+                           int                nregions,
+                           ztloader_t       **loaders,
+                           int                nloaders,
+                           char             **syntax_error);
+
+/**
+ * Abandon an incremental parser without loading anything. This destroys
+ * the parser.
+ *
+ * \param ctx parser (may be NULL)
+ */
+void ztparser_destroy(ztparser_t *ctx);
+
+/* ----------------------------------------------------------------------- */
+
 /**
  * Save
  *
@@ -482,6 +677,102 @@ ztresult_t zt_save(const ztstruct_t *meta,
                    ztsaver_t       **savers,
                    int               nsavers);
 
+/**
+ * Save, as zt_save does, with options.
+ *
+ * \param meta description of 'structure'
+ * \param structure structure to save
+ * \param filename filename to save to
+ * \param regions runtime heap array specs
+ * \param nregions number of heap array specs
+ * \param savers array of saver functions - one per custom ID
+ * \param nsavers number of saver functions
+ * \param flags ztsaveflag_* options
+ */
+ztresult_t zt_save_to_file(const ztstruct_t *meta,
+                           const void       *structure,
+                           const char       *filename,
+                           const ztregion_t *regions,
+                           int               nregions,
+                           ztsaver_t       **savers,
+                           int               nsavers,
+                           ztsaveflags_t     flags);
+
+/**
+ * Save into a memory buffer.
+ *
+ * The buffer is allocated with malloc and the caller must free() it. It is
+ * terminated, though the terminator is not counted in its length.
+ *
+ * \param meta description of 'structure'
+ * \param structure structure to save
+ * \param pbuffer updated with the saved text
+ * \param plength updated with the length of the saved text in bytes
+ * \param regions runtime heap array specs
+ * \param nregions number of heap array specs
+ * \param savers array of saver functions - one per custom ID
+ * \param nsavers number of saver functions
+ * \param flags ztsaveflag_* options
+ */
+ztresult_t zt_save_to_buffer(const ztstruct_t *meta,
+                             const void       *structure,
+                             char            **pbuffer,
+                             size_t           *plength,
+                             const ztregion_t *regions,
+                             int               nregions,
+                             ztsaver_t       **savers,
+                             int               nsavers,
+                             ztsaveflags_t     flags);
+
+/**
+ * Save by passing the output, in chunks, to a function.
+ *
+ * \param meta description of 'structure'
+ * \param structure structure to save
+ * \param sink function to receive the output
+ * \param opaque passed to 'sink'
+ * \param regions runtime heap array specs
+ * \param nregions number of heap array specs
+ * \param savers array of saver functions - one per custom ID
+ * \param nsavers number of saver functions
+ * \param flags ztsaveflag_* options
+ *
+ * \return the first error returned by 'sink', if any
+ */
+ztresult_t zt_save_to_sink(const ztstruct_t *meta,
+                           const void       *structure,
+                           ztsink_t         *sink,
+                           void             *opaque,
+                           const ztregion_t *regions,
+                           int               nregions,
+                           ztsaver_t       **savers,
+                           int               nsavers,
+                           ztsaveflags_t     flags);
+
+/**
+ * Measure what would be saved, without producing any output.
+ *
+ * Custom savers are still called.
+ *
+ * \param meta description of 'structure'
+ * \param structure structure to measure
+ * \param plength updated with the exact length in bytes of the text which
+ * the other save functions would produce
+ * \param regions runtime heap array specs
+ * \param nregions number of heap array specs
+ * \param savers array of saver functions - one per custom ID
+ * \param nsavers number of saver functions
+ * \param flags ztsaveflag_* options, as they would be given to the save
+ */
+ztresult_t zt_save_measure(const ztstruct_t *meta,
+                           const void       *structure,
+                           size_t           *plength,
+                           const ztregion_t *regions,
+                           int               nregions,
+                           ztsaver_t       **savers,
+                           int               nsavers,
+                           ztsaveflags_t     flags);
+
 /* ----------------------------------------------------------------------- */
 
 #ifdef __cplusplus
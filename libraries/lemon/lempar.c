@@ -869,195 +869,212 @@ static void yy_accept(
   ParseCTX_STORE
 }
 
-/* The main parser program.
-** The first argument is a pointer to a structure obtained from
-** "ParseAlloc" which describes the current state of the parser.
-** The second argument is the major token number.  The third is
-** the minor token.  The fourth optional argument is whatever the
-** user wants (and specified in the grammar) and is available for
-** use by the action routines.
-**
-** Inputs:
-** <ul>
-** <li> A pointer to the parser (an opaque structure.)
-** <li> The major token number.
-** <li> The minor token number.
-** <li> An option argument of a grammar-specified type.
-** </ul>
-**
-** Outputs:
-** None.
+/* Feed the parser a batch of tokens. This is equivalent to calling Parse()
+** once for each token in turn but avoids the per-call overhead and keeps
+** the parser's working set hot across the batch.
 */
-void Parse(
+void ParseBatch(
   void *yyp,                   /* The parser */
-  int yymajor,                 /* The major token code number */
-  ParseTOKENTYPE yyminor       /* The value for the token */
+  const int *yymajors,         /* The major token code numbers */
+  ParseTOKENTYPE const *yyminors, /* The values for the tokens */
+  int nToken                   /* How many tokens */
   ParseARG_PDECL               /* Optional %extra_argument parameter */
 ){
   YYMINORTYPE yyminorunion;
   YYACTIONTYPE yyact;   /* The parser action. */
-#if !defined(YYERRORSYMBOL) && !defined(YYNOERRORRECOVERY)
-  int yyendofinput;     /* True if we are at the end of input */
-#endif
-#ifdef YYERRORSYMBOL
-  int yyerrorhit = 0;   /* True if yymajor has invoked an error */
-#endif
+  int yyi;
   yyParser *yypParser = (yyParser*)yyp;  /* The parser */
   ParseCTX_FETCH
   ParseARG_STORE
 
   assert( yypParser->yytos!=0 );
+
+  for(yyi=0; yyi<nToken; yyi++){
+    int yymajor = yymajors[yyi];
+    ParseTOKENTYPE yyminor = yyminors[yyi];
 #if !defined(YYERRORSYMBOL) && !defined(YYNOERRORRECOVERY)
-  yyendofinput = (yymajor==0);
+    int yyendofinput = (yymajor==0);  /* True if we are at the end of input */
+#endif
+#ifdef YYERRORSYMBOL
+    int yyerrorhit = 0;   /* True if yymajor has invoked an error */
 #endif
 
-  yyact = yypParser->yytos->stateno;
+    yyact = yypParser->yytos->stateno;
 #ifndef NDEBUG
-  if( yyTraceFILE ){
-    if( yyact < YY_MIN_REDUCE ){
-      fprintf(yyTraceFILE,"%sInput '%s' in state %d\n",
-              yyTracePrompt,yyTokenName[yymajor],yyact);
-    }else{
-      fprintf(yyTraceFILE,"%sInput '%s' with pending reduce %d\n",
-              yyTracePrompt,yyTokenName[yymajor],yyact-YY_MIN_REDUCE);
+    if( yyTraceFILE ){
+      if( yyact < YY_MIN_REDUCE ){
+        fprintf(yyTraceFILE,"%sInput '%s' in state %d\n",
+                yyTracePrompt,yyTokenName[yymajor],yyact);
+      }else{
+        fprintf(yyTraceFILE,"%sInput '%s' with pending reduce %d\n",
+                yyTracePrompt,yyTokenName[yymajor],yyact-YY_MIN_REDUCE);
+      }
     }
-  }
 #endif
 
-  do{
-    assert( yyact==yypParser->yytos->stateno );
-    yyact = yy_find_shift_action((YYCODETYPE)yymajor,yyact);
-    if( yyact >= YY_MIN_REDUCE ){
-      yyact = yy_reduce(yypParser,yyact-YY_MIN_REDUCE,yymajor,
-                        yyminor ParseCTX_PARAM);
-    }else if( yyact <= YY_MAX_SHIFTREDUCE ){
-      yy_shift(yypParser,yyact,(YYCODETYPE)yymajor,yyminor);
+    do{
+      assert( yyact==yypParser->yytos->stateno );
+      yyact = yy_find_shift_action((YYCODETYPE)yymajor,yyact);
+      if( yyact >= YY_MIN_REDUCE ){
+        yyact = yy_reduce(yypParser,yyact-YY_MIN_REDUCE,yymajor,
+                          yyminor ParseCTX_PARAM);
+      }else if( yyact <= YY_MAX_SHIFTREDUCE ){
+        yy_shift(yypParser,yyact,(YYCODETYPE)yymajor,yyminor);
 #ifndef YYNOERRORRECOVERY
-      yypParser->yyerrcnt--;
+        yypParser->yyerrcnt--;
 #endif
-      break;
-    }else if( yyact==YY_ACCEPT_ACTION ){
-      yypParser->yytos--;
-      yy_accept(yypParser);
-      return;
-    }else{
-      assert( yyact == YY_ERROR_ACTION );
-      yyminorunion.yy0 = yyminor;
+        break;
+      }else if( yyact==YY_ACCEPT_ACTION ){
+        yypParser->yytos--;
+        yy_accept(yypParser);
+        return; /* anything after the end of input is ignored */
+      }else{
+        assert( yyact == YY_ERROR_ACTION );
+        yyminorunion.yy0 = yyminor;
 #ifdef YYERRORSYMBOL
-      int yymx;
-#endif
-#ifndef NDEBUG
-      if( yyTraceFILE ){
-        fprintf(yyTraceFILE,"%sSyntax Error!\n",yyTracePrompt);
-      }
+        int yymx;
 #endif
-#ifdef YYERRORSYMBOL
-      /* A syntax error has occurred.
-      ** The response to an error depends upon whether or not the
-      ** grammar defines an error token "ERROR".  
-      **
-      ** This is what we do if the grammar does define ERROR:
-      **
-      **  * Call the %syntax_error function.
-      **
-      **  * Begin popping the stack until we enter a state where
-      **    it is legal to shift the error symbol, then shift
-      **    the error symbol.
-      **
-      **  * Set the error count to three.
-      **
-      **  * Begin accepting and shifting new tokens.  No new error
-      **    processing will occur until three tokens have been
-      **    shifted successfully.
-      **
-      */
-      if( yypParser->yyerrcnt<0 ){
-        yy_syntax_error(yypParser,yymajor,yyminor);
-      }
-      yymx = yypParser->yytos->major;
-      if( yymx==YYERRORSYMBOL || yyerrorhit ){
 #ifndef NDEBUG
         if( yyTraceFILE ){
-          fprintf(yyTraceFILE,"%sDiscard input token %s\n",
-             yyTracePrompt,yyTokenName[yymajor]);
+          fprintf(yyTraceFILE,"%sSyntax Error!\n",yyTracePrompt);
         }
 #endif
-        yy_destructor(yypParser, (YYCODETYPE)yymajor, &yyminorunion);
-        yymajor = YYNOCODE;
-      }else{
-        while( yypParser->yytos >= yypParser->yystack
-            && (yyact = yy_find_reduce_action(
-                        yypParser->yytos->stateno,
-                        YYERRORSYMBOL)) > YY_MAX_SHIFTREDUCE
-        ){
-          yy_pop_parser_stack(yypParser);
+#ifdef YYERRORSYMBOL
+        /* A syntax error has occurred.
+        ** The response to an error depends upon whether or not the
+        ** grammar defines an error token "ERROR".  
+        **
+        ** This is what we do if the grammar does define ERROR:
+        **
+        **  * Call the %syntax_error function.
+        **
+        **  * Begin popping the stack until we enter a state where
+        **    it is legal to shift the error symbol, then shift
+        **    the error symbol.
+        **
+        **  * Set the error count to three.
+        **
+        **  * Begin accepting and shifting new tokens.  No new error
+        **    processing will occur until three tokens have been
+        **    shifted successfully.
+        **
+        */
+        if( yypParser->yyerrcnt<0 ){
+          yy_syntax_error(yypParser,yymajor,yyminor);
         }
-        if( yypParser->yytos < yypParser->yystack || yymajor==0 ){
-          yy_destructor(yypParser,(YYCODETYPE)yymajor,&yyminorunion);
-          yy_parse_failed(yypParser);
-#ifndef YYNOERRORRECOVERY
-          yypParser->yyerrcnt = -1;
+        yymx = yypParser->yytos->major;
+        if( yymx==YYERRORSYMBOL || yyerrorhit ){
+#ifndef NDEBUG
+          if( yyTraceFILE ){
+            fprintf(yyTraceFILE,"%sDiscard input token %s\n",
+               yyTracePrompt,yyTokenName[yymajor]);
+          }
 #endif
+          yy_destructor(yypParser, (YYCODETYPE)yymajor, &yyminorunion);
           yymajor = YYNOCODE;
-        }else if( yymx!=YYERRORSYMBOL ){
-          yy_shift(yypParser,yyact,YYERRORSYMBOL,yyminor);
+        }else{
+          while( yypParser->yytos >= yypParser->yystack
+              && (yyact = yy_find_reduce_action(
+                          yypParser->yytos->stateno,
+                          YYERRORSYMBOL)) > YY_MAX_SHIFTREDUCE
+          ){
+            yy_pop_parser_stack(yypParser);
+          }
+          if( yypParser->yytos < yypParser->yystack || yymajor==0 ){
+            yy_destructor(yypParser,(YYCODETYPE)yymajor,&yyminorunion);
+            yy_parse_failed(yypParser);
+#ifndef YYNOERRORRECOVERY
+            yypParser->yyerrcnt = -1;
+#endif
+            yymajor = YYNOCODE;
+          }else if( yymx!=YYERRORSYMBOL ){
+            yy_shift(yypParser,yyact,YYERRORSYMBOL,yyminor);
+          }
         }
-      }
-      yypParser->yyerrcnt = 3;
-      yyerrorhit = 1;
-      if( yymajor==YYNOCODE ) break;
-      yyact = yypParser->yytos->stateno;
+        yypParser->yyerrcnt = 3;
+        yyerrorhit = 1;
+        if( yymajor==YYNOCODE ) break;
+        yyact = yypParser->yytos->stateno;
 #elif defined(YYNOERRORRECOVERY)
-      /* If the YYNOERRORRECOVERY macro is defined, then do not attempt to
-      ** do any kind of error recovery.  Instead, simply invoke the syntax
-      ** error routine and continue going as if nothing had happened.
-      **
-      ** Applications can set this macro (for example inside %include) if
-      ** they intend to abandon the parse upon the first syntax error seen.
-      */
-      yy_syntax_error(yypParser,yymajor, yyminor);
-      yy_destructor(yypParser,(YYCODETYPE)yymajor,&yyminorunion);
-      break;
-#else  /* YYERRORSYMBOL is not defined */
-      /* This is what we do if the grammar does not define ERROR:
-      **
-      **  * Report an error message, and throw away the input token.
-      **
-      **  * If the input token is $, then fail the parse.
-      **
-      ** As before, subsequent error messages are suppressed until
-      ** three input tokens have been successfully shifted.
-      */
-      if( yypParser->yyerrcnt<=0 ){
+        /* If the YYNOERRORRECOVERY macro is defined, then do not attempt to
+        ** do any kind of error recovery.  Instead, simply invoke the syntax
+        ** error routine and continue going as if nothing had happened.
+        **
+        ** Applications can set this macro (for example inside %include) if
+        ** they intend to abandon the parse upon the first syntax error seen.
+        */
         yy_syntax_error(yypParser,yymajor, yyminor);
-      }
-      yypParser->yyerrcnt = 3;
-      yy_destructor(yypParser,(YYCODETYPE)yymajor,&yyminorunion);
-      if( yyendofinput ){
-        yy_parse_failed(yypParser);
+        yy_destructor(yypParser,(YYCODETYPE)yymajor,&yyminorunion);
+        break;
+#else  /* YYERRORSYMBOL is not defined */
+        /* This is what we do if the grammar does not define ERROR:
+        **
+        **  * Report an error message, and throw away the input token.
+        **
+        **  * If the input token is $, then fail the parse.
+        **
+        ** As before, subsequent error messages are suppressed until
+        ** three input tokens have been successfully shifted.
+        */
+        if( yypParser->yyerrcnt<=0 ){
+          yy_syntax_error(yypParser,yymajor, yyminor);
+        }
+        yypParser->yyerrcnt = 3;
+        yy_destructor(yypParser,(YYCODETYPE)yymajor,&yyminorunion);
+        if( yyendofinput ){
+          yy_parse_failed(yypParser);
 #ifndef YYNOERRORRECOVERY
-        yypParser->yyerrcnt = -1;
+          yypParser->yyerrcnt = -1;
 #endif
-      }
-      break;
+        }
+        break;
 #endif
-    }
-  }while( yypParser->yytos>yypParser->yystack );
+      }
+    }while( yypParser->yytos>yypParser->yystack );
 #ifndef NDEBUG
-  if( yyTraceFILE ){
-    yyStackEntry *i;
-    char cDiv = '[';
-    fprintf(yyTraceFILE,"%sReturn. Stack=",yyTracePrompt);
-    for(i=&yypParser->yystack[1]; i<=yypParser->yytos; i++){
-      fprintf(yyTraceFILE,"%c%s", cDiv, yyTokenName[i->major]);
-      cDiv = ' ';
+    if( yyTraceFILE ){
+      yyStackEntry *i;
+      char cDiv = '[';
+      fprintf(yyTraceFILE,"%sReturn. Stack=",yyTracePrompt);
+      for(i=&yypParser->yystack[1]; i<=yypParser->yytos; i++){
+        fprintf(yyTraceFILE,"%c%s", cDiv, yyTokenName[i->major]);
+        cDiv = ' ';
+      }
+      fprintf(yyTraceFILE,"]\n");
     }
-    fprintf(yyTraceFILE,"]\n");
-  }
 #endif
+  }
   return;
 }
 
+/* The main parser program.
+** The first argument is a pointer to a structure obtained from
+** "ParseAlloc" which describes the current state of the parser.
+** The second argument is the major token number.  The third is
+** the minor token.  The fourth optional argument is whatever the
+** user wants (and specified in the grammar) and is available for
+** use by the action routines.
+**
+** Inputs:
+** <ul>
+** <li> A pointer to the parser (an opaque structure.)
+** <li> The major token number.
+** <li> The minor token number.
+** <li> An option argument of a grammar-specified type.
+** </ul>
+**
+** Outputs:
+** None.
+*/
+void Parse(
+  void *yyp,                   /* The parser */
+  int yymajor,                 /* The major token code number */
+  ParseTOKENTYPE yyminor       /* The value for the token */
+  ParseARG_PDECL               /* Optional %extra_argument parameter */
+){
+  ParseBatch(yyp, &yymajor, &yyminor, 1 ParseARG_PARAM);
+}
+
 /*
 ** Return the fallback token corresponding to canonical token iToken, or
 ** 0 if iToken has no fallback.
@@ -244,24 +244,35 @@ static ztresult_t ztast_viz_scopearray(ztast_viz_state_t        *state,
 ztresult_t ztast_show(ztast_t *ast, const char *filename)
 {
   ztresult_t        rc;
+  ztast_program_t  *program;
   FILE             *file;
   ztast_viz_state_t state;
 
+  /* the graph is drawn from a view of the AST */
+  program = ztast_view_program(ast);
+  if (program == NULL)
+    return ztresult_OOM;
+
   file = fopen(filename, "w");
   if (file == NULL)
+  {
+    ztast_view_program_destroy(program);
     return ztresult_BAD_FOPEN;
+  }
 
   (void) fprintf(file, "digraph \"ast\"\n");
   (void) fprintf(file, "{\n");
   (void) fprintf(file, "\tnode [shape = Mrecord];\n");
 
   state.file = file;
-  rc = ztast_viz_program(&state, ast->program, 0);
+  rc = ztast_viz_program(&state, program, 0);
 
   (void) fprintf(file, "}\n");
 
   fclose(file);
 
+  ztast_view_program_destroy(program);
+
   return rc;
 }
 
@@ -3,9 +3,13 @@
 #include <assert.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "fortify/fortify.h"
 
+#include "zt-hash.h"
+
 #include "zt-ast.h"
 
 /* TODO
@@ -18,18 +22,18 @@
 #define ZTAST_MALLOC(SZ) ast->mallocfn(SZ, ast->opaque)
 #define ZTAST_FREE(P)    do { if (ast->freefn) ast->freefn(P, ast->opaque); } while (0)
 
-/* ----------------------------------------------------------------------- */
-
-static void ztast_destroy_expr(ztast_t      *ast,
-                               ztast_expr_t *expr);
-
-static void ztast_destroy_value(ztast_t       *ast,
-                                ztast_value_t *value);
+/* Initial pool sizes, in elements. */
+#define ZTAST_MINNODES   (64)
+#define ZTAST_MININTS    (64)
+#define ZTAST_MINSTRINGS (256)
+#define ZTAST_MINIDS     (64)
 
 /* ----------------------------------------------------------------------- */
 
 ztast_t *ztast_create(ztast_mallocfn_t  *mallocfn,
                       ztast_freefn_t    *freefn,
+                      ztast_reallocfn_t *reallocfn,
+                      ztast_releasefn_t *releasefn,
                       void              *opaque,
                       ztast_logfn_t     *logfn)
 {
@@ -39,11 +43,33 @@ ztast_t *ztast_create(ztast_mallocfn_t  *mallocfn,
   if (ast == NULL)
     return NULL;
 
-  ast->program  = NULL;
-  
-  ast->mallocfn = mallocfn;
-  ast->freefn   = freefn;
-  ast->opaque   = opaque;
+  ast->program      = 0;
+  ast->haveprogram  = 0;
+
+  /* node zero and string offset zero are reserved to mean "none" */
+  ast->nodes            = NULL;
+  ast->nnodes           = 1;
+  ast->nodesallocated   = 0;
+
+  ast->ints             = NULL;
+  ast->nints            = 0;
+  ast->intsallocated    = 0;
+
+  ast->strings          = NULL;
+  ast->nstrings         = 1;
+  ast->stringsallocated = 0;
+
+  ast->ids          = NULL;
+  ast->nids         = 0;
+  ast->idsallocated = 0;
+
+  ast->oom          = 0;
+
+  ast->mallocfn  = mallocfn;
+  ast->freefn    = freefn;
+  ast->reallocfn = reallocfn;
+  ast->releasefn = releasefn;
+  ast->opaque    = opaque;
 
 #ifdef ZTAST_LOG
   ast->logfn     = logfn;
@@ -52,215 +78,224 @@ ztast_t *ztast_create(ztast_mallocfn_t  *mallocfn,
   return ast;
 }
 
-static void ztast_destroy_statements(ztast_t           *ast,
-                                     ztast_statement_t *statements)
+void ztast_destroy(ztast_t *ast)
 {
-  ztast_statement_t *st;
-  ztast_statement_t *next;
-
-  if (statements == NULL)
-    return; /* no statements */
+  if (ast == NULL)
+    return;
 
-  for (st = statements; st != NULL; st = next)
+  if (ast->releasefn)
   {
-    switch (st->type)
-    {
-    case ZTSTMT_ASSIGNMENT:
-      ztast_destroy_expr(ast, st->u.assignment->expr);
-      ZTAST_FREE(st->u.assignment->id);
-      ZTAST_FREE(st->u.assignment);
-      break;
-
-    default:
-      assert(0);
-      break;
-    }
-    next = st->next;
-    ZTAST_FREE(st);
+    /* the AST itself lives in the memory being released */
+    ast->releasefn(ast->opaque);
+    return;
   }
+
+  ZTAST_FREE(ast->ids);
+  ZTAST_FREE(ast->strings);
+  ZTAST_FREE(ast->ints);
+  ZTAST_FREE(ast->nodes);
+  ZTAST_FREE(ast);
 }
 
-static void ztast_destroy_expr(ztast_t      *ast,
-                               ztast_expr_t *expr)
+/* ----------------------------------------------------------------------- */
+
+/* Grow a pool of 'elsize' byte elements, of which 'used' are in use, so
+ * that it holds at least 'needed'. Returns the new pool, or NULL if out of
+ * memory. */
+static void *ztast_pool_grow(ztast_t      *ast,
+                             void         *pool,
+                             unsigned int  used,
+                             unsigned int  needed,
+                             unsigned int *allocated,
+                             unsigned int  minimum,
+                             size_t        elsize)
 {
-  switch (expr->type)
-  {
-  case ZTEXPR_VALUE:
-    ztast_destroy_value(ast, expr->data.value);
-    break;
+  unsigned int  newallocated;
+  void         *newpool;
 
-  case ZTEXPR_SCOPE:
-    ztast_destroy_statements(ast, expr->data.scope->statements);
-    ZTAST_FREE(expr->data.scope);
-    break;
+  newallocated = *allocated < minimum ? minimum : *allocated * 2;
+  while (newallocated < needed)
+    newallocated *= 2;
 
-  case ZTEXPR_INTARRAY:
+  if (ast->reallocfn)
+  {
+    /* the pool may well be the most recent allocation, in which case the
+     * memory manager can extend it in place */
+    newpool = ast->reallocfn(pool, newallocated * elsize, ast->opaque);
+    if (newpool == NULL)
     {
-      ztast_intarrayinner_t *inner;
-
-      inner = expr->data.intarray->inner;
-      if (inner)
-      {
-        ZTAST_FREE(inner->ints);
-        ZTAST_FREE(inner);
-      }
-      ZTAST_FREE(expr->data.intarray);
+      ast->oom = 1;
+      return NULL;
     }
-    break;
-
-  case ZTEXPR_SCOPEARRAY:
+  }
+  else
+  {
+    newpool = ZTAST_MALLOC(newallocated * elsize);
+    if (newpool == NULL)
     {
-      ztast_scopearrayinner_t *inner;
-
-      inner = expr->data.scopearray->inner;
-      if (inner)
-      {
-        int i;
+      ast->oom = 1;
+      return NULL;
+    }
 
-        for (i = 0; i < inner->nused; i++)
-        {
-          ztast_destroy_statements(ast, inner->scopes[i]->statements);
-          ZTAST_FREE(inner->scopes[i]);
-        }
-        ZTAST_FREE(inner->scopes);
-        ZTAST_FREE(inner);
-      }
-      ZTAST_FREE(expr->data.scopearray);
+    if (pool)
+    {
+      memcpy(newpool, pool, used * elsize);
+      ZTAST_FREE(pool);
     }
-    break;
   }
 
-  ZTAST_FREE(expr);
-}
+  *allocated = newallocated;
 
-static void ztast_destroy_value(ztast_t       *ast,
-                                ztast_value_t *value)
-{
-  ZTAST_FREE(value);
+  return newpool;
 }
 
-void ztast_destroy(ztast_t *ast)
+/* Returns the index of a new node, or zero if out of memory. */
+static ztast_index_t ztast_node_alloc(ztast_t *ast)
 {
-  if (ast == NULL)
-    return;
+  ztast_node_t *node;
 
-  ztast_destroy_statements(ast, ast->program->statements);
+  if (ast->nnodes >= ast->nodesallocated)
+  {
+    ztast_node_t *newnodes;
 
-  ZTAST_FREE(ast->program);
-  ZTAST_FREE(ast);
+    newnodes = ztast_pool_grow(ast, ast->nodes,
+                               ast->nnodes, ast->nnodes + 1,
+                              &ast->nodesallocated, ZTAST_MINNODES,
+                               sizeof(*newnodes));
+    if (newnodes == NULL)
+      return 0;
+
+    ast->nodes = newnodes;
+  }
+
+  node = &ast->nodes[ast->nnodes];
+  node->next = 0;
+  node->name = 0;
+
+  return ast->nnodes++;
 }
 
 /* ----------------------------------------------------------------------- */
 
-ztast_program_t *ztast_program(ztast_t *ast, ztast_statement_t *statements)
+void ztast_program(ztast_t *ast, ztast_index_t statements)
 {
-  ztast_program_t *program;
-
   assert(ast);
-  /* statement may be NULL */
+  /* statements may be zero */
 
 #ifdef ZTAST_LOG
   if (ast->logfn)
     ast->logfn("ztast_program\n");
 #endif
 
-  program = ZTAST_MALLOC(sizeof(*program));
-  if (program == NULL)
-    return NULL;
-
-  program->statements = statements;
-
-  /* Store the initial program pointer in ast_t.
+  /* Store the initial program in ast_t.
    * This is here because it's awkward to do in the parser. */
-  assert(ast->program == NULL);
-  ast->program = program;
-
-  return program;
+  assert(!ast->haveprogram);
+  ast->program     = statements;
+  ast->haveprogram = 1;
 }
 
-void ztast_statement_append(ztast_t           *ast,
-                            ztast_statement_t *statementlist,
-                            ztast_statement_t *appendee)
+void ztast_statement_append(ztast_t       *ast,
+                            ztast_list_t  *statementlist,
+                            ztast_index_t  appendee)
 {
-  ztast_statement_t *stmt;
-
   assert(ast);
   assert(statementlist);
-  assert(appendee);
 
 #ifdef ZTAST_LOG
   if (ast->logfn)
-    ast->logfn("ztast_statement_append %p to %p", appendee, statementlist);
+    ast->logfn("ztast_statement_append %u to %u", appendee, statementlist->head);
 #endif
 
-  for (stmt = statementlist; stmt->next != NULL; stmt = stmt->next)
-    ;
-  stmt->next = appendee;
+  if (appendee == 0)
+    return; /* out of memory */
+
+  if (statementlist->tail)
+    ZTAST_NODE(ast, statementlist->tail)->next = appendee;
+  else
+    statementlist->head = appendee;
 
 #ifdef ZTAST_LOG
   if (ast->logfn)
-    ast->logfn(" -> %p\n", stmt);
+    ast->logfn(" -> %u\n", statementlist->tail);
 #endif
+
+  statementlist->tail = appendee;
+  statementlist->count++;
 }
 
-ztast_statement_t *ztast_statement_from_assignment(ztast_t            *ast,
-                                                   ztast_assignment_t *assignment)
+ztast_index_t ztast_assignment(ztast_t          *ast,
+                               unsigned int      name,
+                         const ztast_exprnode_t *expr)
 {
-  ztast_statement_t *stmt;
+  ztast_index_t index;
+  ztast_node_t *node;
 
   assert(ast);
-  assert(assignment);
+  assert(expr);
 
 #ifdef ZTAST_LOG
   if (ast->logfn)
-    ast->logfn("ztast_statement_from_assignment %p", assignment);
+    ast->logfn("ztast_assignment\n");
 #endif
 
-  stmt = ZTAST_MALLOC(sizeof(*stmt));
-  if (stmt == NULL)
-    return NULL;
+  if (name == 0)
+    return 0; /* out of memory */
 
-  stmt->next         = NULL;
-  stmt->type         = ZTSTMT_ASSIGNMENT;
-  stmt->u.assignment = assignment;
+  index = ztast_node_alloc(ast);
+  if (index == 0)
+    return 0;
 
-#ifdef ZTAST_LOG
-  if (ast->logfn)
-    ast->logfn(" -> %p\n", stmt);
-#endif
+  node = ZTAST_NODE(ast, index);
+  node->name = name;
+  node->expr = *expr;
 
-  return stmt;
+  return index;
 }
 
-ztast_assignment_t *ztast_assignment(ztast_t      *ast,
-                                     ztast_id_t   *id,
-                                     ztast_expr_t *expr)
+/* Double the size of the identifier table (or create it). */
+static int ztast_id_grow(ztast_t *ast)
 {
-  ztast_assignment_t *ass;
+  int           newsize;
+  unsigned int *newids;
+  int           i;
 
-  assert(ast);
-  assert(id);
-  assert(expr);
+  newsize = ast->idsallocated ? ast->idsallocated * 2 : ZTAST_MINIDS;
+  newids = ZTAST_MALLOC(newsize * sizeof(*newids));
+  if (newids == NULL)
+  {
+    ast->oom = 1;
+    return 0;
+  }
 
-#ifdef ZTAST_LOG
-  if (ast->logfn)
-    ast->logfn("ztast_assignment\n");
-#endif
+  memset(newids, 0, newsize * sizeof(*newids));
 
-  ass = ZTAST_MALLOC(sizeof(*ass));
-  if (ass == NULL)
-    return NULL;
+  for (i = 0; i < ast->idsallocated; i++)
+  {
+    const char   *name;
+    unsigned int  j;
+
+    if (ast->ids[i] == 0)
+      continue;
+
+    name = ast->strings + ast->ids[i];
+    j = zt_hash_string(name, strlen(name));
+    while (newids[j & (newsize - 1)])
+      j++;
+    newids[j & (newsize - 1)] = ast->ids[i];
+  }
+
+  ZTAST_FREE(ast->ids);
 
-  ass->id   = id;
-  ass->expr = expr;
+  ast->ids          = newids;
+  ast->idsallocated = newsize;
 
-  return ass;
+  return 1;
 }
 
-ztast_id_t *ztast_id(ztast_t *ast, const char *name)
+unsigned int ztast_id(ztast_t *ast, const char *name, size_t length)
 {
-  size_t      namelen;
-  ztast_id_t *id;
+  unsigned int j;
+  unsigned int offset;
 
   assert(ast);
   assert(name);
@@ -270,326 +305,580 @@ ztast_id_t *ztast_id(ztast_t *ast, const char *name)
     ast->logfn("ztast_id\n");
 #endif
 
-  namelen = strlen(name);
-  id = ZTAST_MALLOC(offsetof(ztast_id_t, name) + namelen + 1);
-  if (id == NULL)
-    return NULL;
+  /* keep the table at most three quarters full */
+  if (ZTHASH_FULL(ast->nids, ast->idsallocated))
+    if (!ztast_id_grow(ast))
+      return 0;
+
+  for (j = zt_hash_string(name, length); ; j++)
+  {
+    const char *interned;
 
-  memcpy(id->name, name, namelen + 1);
+    offset = ast->ids[j & (ast->idsallocated - 1)];
+    if (offset == 0)
+      break;
+    interned = ast->strings + offset;
+    if (strncmp(interned, name, length) == 0 && interned[length] == '\0')
+      return offset; /* already interned */
+  }
 
-  return id;
+  if (ast->nstrings + length + 1 > ast->stringsallocated)
+  {
+    char *newstrings;
+
+    newstrings = ztast_pool_grow(ast, ast->strings,
+                                 ast->nstrings, ast->nstrings + length + 1,
+                                &ast->stringsallocated, ZTAST_MINSTRINGS,
+                                 sizeof(*newstrings));
+    if (newstrings == NULL)
+      return 0;
+
+    ast->strings = newstrings;
+  }
+
+  offset = ast->nstrings;
+  memcpy(ast->strings + offset, name, length);
+  ast->strings[offset + length] = '\0';
+  ast->nstrings += length + 1;
+
+  ast->ids[j & (ast->idsallocated - 1)] = offset;
+  ast->nids++;
+
+  return offset;
 }
 
-ztast_expr_t *ztast_expr_from_value(ztast_t *ast, ztast_value_t *value)
+ztast_exprnode_t ztast_expr_from_integer(ztast_t *ast, int integer)
 {
-  ztast_expr_t *expr;
+  ztast_exprnode_t expr;
 
   assert(ast);
-  assert(value);
 
 #ifdef ZTAST_LOG
   if (ast->logfn)
-    ast->logfn("ztast_expr_from_value\n");
+    ast->logfn("ztast_expr_from_integer\n");
 #endif
 
-  expr = ZTAST_MALLOC(sizeof(*expr));
-  if (expr == NULL)
-    return NULL;
-
-  expr->type       = ZTEXPR_VALUE;
-  expr->data.value = value;
+  expr.type      = ZTEXPR_VALUE;
+  expr.valuetype = ZTVAL_INTEGER;
+  expr.u.integer = integer;
 
   return expr;
 }
 
-ztast_expr_t *ztast_expr_from_scope(ztast_t *ast, ztast_scope_t *scope)
+ztast_exprnode_t ztast_expr_from_decimal(ztast_t *ast, int decimal)
 {
-  ztast_expr_t *expr;
+  ztast_exprnode_t expr;
 
   assert(ast);
-  assert(scope);
 
 #ifdef ZTAST_LOG
   if (ast->logfn)
-    ast->logfn("ztast_expr_from_scope\n");
+    ast->logfn("ztast_expr_from_decimal\n");
 #endif
 
-  expr = ZTAST_MALLOC(sizeof(*expr));
-  if (expr == NULL)
-    return NULL;
-
-  expr->type       = ZTEXPR_SCOPE;
-  expr->data.scope = scope;
+  expr.type      = ZTEXPR_VALUE;
+  expr.valuetype = ZTVAL_DECIMAL;
+  expr.u.decimal = decimal;
 
   return expr;
 }
 
-ztast_expr_t *ztast_expr_from_intarray(ztast_t *ast, ztast_intarray_t *intarr)
+ztast_exprnode_t ztast_expr_nil(ztast_t *ast)
 {
-  ztast_expr_t *expr;
+  ztast_exprnode_t expr;
 
   assert(ast);
-  assert(intarr);
 
 #ifdef ZTAST_LOG
   if (ast->logfn)
-    ast->logfn("ztast_expr_from_array\n");
+    ast->logfn("ztast_expr_nil\n");
 #endif
 
-  expr = ZTAST_MALLOC(sizeof(*expr));
-  if (expr == NULL)
-    return NULL;
-
-  expr->type          = ZTEXPR_INTARRAY;
-  expr->data.intarray = intarr;
+  expr.type      = ZTEXPR_VALUE;
+  expr.valuetype = ZTVAL_NIL;
+  expr.u.integer = 0;
 
   return expr;
 }
 
-ztast_expr_t *ztast_expr_from_scopearray(ztast_t            *ast,
-                                         ztast_scopearray_t *scopearr)
+ztast_exprnode_t ztast_expr_from_scope(ztast_t *ast, ztast_index_t statements)
 {
-  ztast_expr_t *expr;
+  ztast_exprnode_t expr;
 
   assert(ast);
-  assert(scopearr);
+  /* statements may be zero */
 
 #ifdef ZTAST_LOG
   if (ast->logfn)
-    ast->logfn("ztast_expr_from_array\n");
+    ast->logfn("ztast_expr_from_scope\n");
 #endif
 
-  expr = ZTAST_MALLOC(sizeof(*expr));
-  if (expr == NULL)
-    return NULL;
-
-  expr->type            = ZTEXPR_SCOPEARRAY;
-  expr->data.scopearray = scopearr;
+  expr.type         = ZTEXPR_SCOPE;
+  expr.valuetype    = 0;
+  expr.u.statements = statements;
 
   return expr;
 }
 
-ztast_value_t *ztast_value_from_integer(ztast_t *ast, int integer)
+ztast_exprnode_t ztast_expr_from_intarray(ztast_t          *ast,
+                                    const ztast_intslice_t *inner)
 {
-  ztast_value_t *val;
+  ztast_exprnode_t expr;
 
   assert(ast);
+  /* inner may be NULL */
 
 #ifdef ZTAST_LOG
   if (ast->logfn)
-    ast->logfn("ztast_value_from_integer\n");
+    ast->logfn("ztast_expr_from_intarray\n");
 #endif
 
-  val = ZTAST_MALLOC(sizeof(*val));
-  if (val == NULL)
-    return NULL;
-
-  val->type         = ZTVAL_INTEGER;
-  val->data.integer = integer;
+  expr.type      = ZTEXPR_INTARRAY;
+  expr.valuetype = 0;
+  if (inner)
+  {
+    expr.u.ints = *inner;
+  }
+  else
+  {
+    expr.u.ints.first = 0;
+    expr.u.ints.count = 0;
+  }
 
-  return val;
+  return expr;
 }
 
-ztast_value_t *ztast_value_from_decimal(ztast_t *ast, int decimal)
+ztast_exprnode_t ztast_expr_from_scopearray(ztast_t      *ast,
+                                      const ztast_list_t *inner)
 {
-  ztast_value_t *val;
+  ztast_exprnode_t expr;
 
   assert(ast);
+  assert(inner);
 
 #ifdef ZTAST_LOG
   if (ast->logfn)
-    ast->logfn("ztast_value_from_decimal\n");
+    ast->logfn("ztast_expr_from_scopearray\n");
 #endif
 
-  val = ZTAST_MALLOC(sizeof(*val));
-  if (val == NULL)
-    return NULL;
-
-  val->type         = ZTVAL_DECIMAL;
-  val->data.decimal = decimal;
+  expr.type           = ZTEXPR_SCOPEARRAY;
+  expr.valuetype      = 0;
+  expr.u.scopes.first = inner->head;
+  expr.u.scopes.count = inner->count;
 
-  return val;
+  return expr;
 }
 
-ztast_value_t *ztast_value_nil(ztast_t *ast)
+/* Make room for 'n' more integers. Returns zero if out of memory. */
+static int ztast_ints_reserve(ztast_t *ast, unsigned int n)
 {
-  ztast_value_t *val;
+  unsigned int *newints;
 
-  assert(ast);
+  if (ast->nints + n <= ast->intsallocated)
+    return 1;
 
-#ifdef ZTAST_LOG
-  if (ast->logfn)
-    ast->logfn("ztast_value_nil\n");
-#endif
-
-  val = ZTAST_MALLOC(sizeof(*val));
-  if (val == NULL)
-    return NULL;
+  newints = ztast_pool_grow(ast, ast->ints,
+                            ast->nints, ast->nints + n,
+                           &ast->intsallocated, ZTAST_MININTS,
+                            sizeof(*newints));
+  if (newints == NULL)
+    return 0;
 
-  val->type = ZTVAL_NIL;
+  ast->ints = newints;
 
-  return val;
+  return 1;
 }
 
-ztast_scope_t *ztast_scope(ztast_t *ast, ztast_statement_t *stmt)
+ztast_intslice_t ztast_intarrayinner_append(ztast_t          *ast,
+                                      const ztast_intslice_t *inner,
+                                            int               val)
 {
-  ztast_scope_t *scope;
+  ztast_intslice_t slice;
 
   assert(ast);
-  /* statement may be NULL */
+  /* inner may be NULL - which means create */
 
 #ifdef ZTAST_LOG
   if (ast->logfn)
-    ast->logfn("ztast_scope\n");
+    ast->logfn("ztast_intarrayinner_append\n");
 #endif
 
-  scope = ZTAST_MALLOC(sizeof(*scope));
-  if (scope == NULL)
-    return NULL;
+  if (inner == NULL)
+  {
+    slice.first = ast->nints;
+    slice.count = 0;
+  }
+  else
+  {
+    slice = *inner;
+  }
+
+  /* arrays are built one at a time, so each one is at the end of the pool */
+  assert(slice.first + slice.count == ast->nints);
+
+  if (!ztast_ints_reserve(ast, 1))
+    return slice;
 
-  scope->statements = stmt;
+  ast->ints[ast->nints++] = val;
+  slice.count++;
 
-  return scope;
+  return slice;
 }
 
-ztast_intarray_t *ztast_intarray(ztast_t *ast, ztast_intarrayinner_t *inner)
+ztast_intslice_t ztast_intarrayinner_append_run(ztast_t          *ast,
+                                          const ztast_intslice_t *inner,
+                                          const unsigned int     *values,
+                                                int               nvalues)
 {
-  ztast_intarray_t *intarr;
+  ztast_intslice_t slice;
 
   assert(ast);
-  /* inner may be NULL */
+  /* inner may be NULL - which means create */
+  assert(values);
+  assert(nvalues > 0);
 
 #ifdef ZTAST_LOG
   if (ast->logfn)
-    ast->logfn("ztast_intarray\n");
+    ast->logfn("ztast_intarrayinner_append_run %d\n", nvalues);
 #endif
 
-  intarr = ZTAST_MALLOC(sizeof(*intarr));
-  if (intarr == NULL)
-    return NULL;
+  if (inner == NULL)
+  {
+    slice.first = ast->nints;
+    slice.count = 0;
+  }
+  else
+  {
+    slice = *inner;
+  }
 
-  intarr->inner = inner;
+  assert(slice.first + slice.count == ast->nints);
 
-  return intarr;
+  if (!ztast_ints_reserve(ast, nvalues))
+    return slice;
+
+  memcpy(ast->ints + ast->nints, values, nvalues * sizeof(*values));
+  ast->nints  += nvalues;
+  slice.count += nvalues;
+
+  return slice;
 }
 
-ztast_intarrayinner_t *ztast_intarrayinner_append(ztast_t               *ast,
-                                                  ztast_intarrayinner_t *inner,
-                                                  int                    val)
+ztast_list_t ztast_scopearrayinner_append(ztast_t       *ast,
+                                    const ztast_list_t  *inner,
+                                          ztast_index_t  statements)
 {
+  ztast_list_t  list;
+  ztast_index_t index;
+  ztast_node_t *node;
+
   assert(ast);
-  /* inner may be NULL - which means allocate */
+  /* inner may be NULL - which means create */
+  /* statements may be zero */
 
 #ifdef ZTAST_LOG
   if (ast->logfn)
-    ast->logfn("ztast_intarrayinner_append\n");
+    ast->logfn("ztast_scopearrayinner_append\n");
 #endif
 
   if (inner == NULL)
   {
-    inner = ZTAST_MALLOC(sizeof(*inner));
-    if (inner == NULL)
-      return NULL;
+    list.head  = 0;
+    list.tail  = 0;
+    list.count = 0;
+  }
+  else
+  {
+    list = *inner;
+  }
+
+  index = ztast_node_alloc(ast);
+  if (index == 0)
+    return list;
 
-    inner->nused      = 0;
-    inner->nallocated = 0;
-    inner->ints       = NULL;
+  node = ZTAST_NODE(ast, index);
+  node->expr = ztast_expr_from_scope(ast, statements);
+
+  if (list.tail)
+    ZTAST_NODE(ast, list.tail)->next = index;
+  else
+    list.head = index;
+  list.tail = index;
+  list.count++;
+
+  return list;
+}
+
+/* ----------------------------------------------------------------------- */
+
+/* Views are built with calloc so that a partly built view can be destroyed
+ * if we run out of memory. Strings and integers are not copied: views
+ * point into the pools. */
+
+static void ztast_view_statements_destroy(ztast_statement_t *statements)
+{
+  ztast_statement_t *st;
+  ztast_statement_t *next;
+
+  for (st = statements; st != NULL; st = next)
+  {
+    if (st->u.assignment)
+    {
+      ztast_view_expr_destroy(st->u.assignment->expr);
+      free(st->u.assignment);
+    }
+    next = st->next;
+    free(st);
   }
+}
+
+void ztast_view_expr_destroy(ztast_expr_t *expr)
+{
+  if (expr == NULL)
+    return;
 
-  if (inner->nused == inner->nallocated)
+  switch (expr->type)
   {
-    int           newarrlen;
-    unsigned int *newarr;
+  case ZTEXPR_VALUE:
+    free(expr->data.value);
+    break;
 
-    /* This code pattern would use realloc() normally but our simple memory
-     * manager doesn't currently feature it. */
+  case ZTEXPR_SCOPE:
+    if (expr->data.scope)
+    {
+      ztast_view_statements_destroy(expr->data.scope->statements);
+      free(expr->data.scope);
+    }
+    break;
 
-    newarrlen = inner->nallocated < 8 ? 8 : inner->nallocated * 2;
-    newarr = ZTAST_MALLOC(newarrlen * sizeof(*newarr));
-    if (newarr == NULL)
-      return NULL;
+  case ZTEXPR_INTARRAY:
+    if (expr->data.intarray)
+    {
+      free(expr->data.intarray->inner);
+      free(expr->data.intarray);
+    }
+    break;
 
-    memcpy(newarr, inner->ints, inner->nallocated * sizeof(*newarr));
-    ZTAST_FREE(inner->ints);
+  case ZTEXPR_SCOPEARRAY:
+    if (expr->data.scopearray)
+    {
+      ztast_scopearrayinner_t *inner;
 
-    inner->nallocated = newarrlen;
-    inner->ints       = newarr;
-  }
+      inner = expr->data.scopearray->inner;
+      if (inner)
+      {
+        int i;
 
-  inner->ints[inner->nused++] = val;
+        for (i = 0; i < inner->nused; i++)
+        {
+          ztast_view_statements_destroy(inner->scopes[i]->statements);
+          free(inner->scopes[i]);
+        }
+        free(inner->scopes);
+        free(inner);
+      }
+      free(expr->data.scopearray);
+    }
+    break;
+  }
 
-  return inner;
+  free(expr);
 }
 
-ztast_scopearray_t *ztast_scopearray(ztast_t                 *ast,
-                                     ztast_scopearrayinner_t *inner)
+/* Returns zero if out of memory, leaving a partial list in '*pstatements'. */
+static int ztast_view_statements(const ztast_t            *ast,
+                                 ztast_index_t             index,
+                                 ztast_statement_t       **pstatements)
 {
-  ztast_scopearray_t *scopearr;
+  ztast_statement_t **plink;
 
-  assert(ast);
-  /* inner may be NULL */
+  plink = pstatements;
+  *plink = NULL;
 
-#ifdef ZTAST_LOG
-  if (ast->logfn)
-    ast->logfn("ztast_scopearray\n");
-#endif
+  for (; index; index = ZTAST_NODE(ast, index)->next)
+  {
+    const ztast_node_t *node = ZTAST_NODE(ast, index);
+    ztast_statement_t  *stmt;
+    ztast_assignment_t *ass;
 
-  scopearr = ZTAST_MALLOC(sizeof(*scopearr));
-  if (scopearr == NULL)
-    return NULL;
+    stmt = calloc(1, sizeof(*stmt));
+    if (stmt == NULL)
+      return 0;
+
+    *plink = stmt;
+    plink  = &stmt->next;
+
+    stmt->type = ZTSTMT_ASSIGNMENT;
+
+    ass = calloc(1, sizeof(*ass));
+    if (ass == NULL)
+      return 0;
 
-  scopearr->inner = inner;
+    stmt->u.assignment = ass;
 
-  return scopearr;
+    /* a ztast_id_t is nothing more than its characters */
+    ass->id   = (ztast_id_t *) ZTAST_NAME(ast, node);
+    ass->expr = ztast_view_expr(ast, &node->expr);
+    if (ass->expr == NULL)
+      return 0;
+  }
+
+  return 1;
 }
 
-ztast_scopearrayinner_t *ztast_scopearrayinner_append(ztast_t                 *ast,
-                                                      ztast_scopearrayinner_t *inner,
-                                                      ztast_scope_t           *scope)
+ztast_expr_t *ztast_view_expr(const ztast_t *ast, const ztast_exprnode_t *exprnode)
 {
+  ztast_expr_t *expr;
+
   assert(ast);
-  /* inner may be NULL - which means allocate */
-  assert(scope);
+  assert(exprnode);
 
-#ifdef ZTAST_LOG
-  if (ast->logfn)
-    ast->logfn("ztast_scopearrayinner_append\n");
-#endif
+  expr = calloc(1, sizeof(*expr));
+  if (expr == NULL)
+    return NULL;
 
-  if (inner == NULL)
+  expr->type = exprnode->type;
+
+  switch (exprnode->type)
   {
-    inner = ZTAST_MALLOC(sizeof(*inner));
-    if (inner == NULL)
-      return NULL;
+  case ZTEXPR_VALUE:
+    {
+      ztast_value_t *value;
+
+      value = calloc(1, sizeof(*value));
+      if (value == NULL)
+        goto failure;
+
+      expr->data.value = value;
+
+      value->type = exprnode->valuetype;
+      if (value->type == ZTVAL_DECIMAL)
+        value->data.decimal = exprnode->u.decimal;
+      else
+        value->data.integer = exprnode->u.integer;
+    }
+    break;
+
+  case ZTEXPR_SCOPE:
+    {
+      ztast_scope_t *scope;
+
+      scope = calloc(1, sizeof(*scope));
+      if (scope == NULL)
+        goto failure;
+
+      expr->data.scope = scope;
+
+      if (!ztast_view_statements(ast, exprnode->u.statements, &scope->statements))
+        goto failure;
+    }
+    break;
+
+  case ZTEXPR_INTARRAY:
+    {
+      ztast_intarray_t      *intarr;
+      ztast_intarrayinner_t *inner;
+
+      intarr = calloc(1, sizeof(*intarr));
+      if (intarr == NULL)
+        goto failure;
+
+      expr->data.intarray = intarr;
+
+      if (exprnode->u.ints.count == 0)
+        break; /* an empty array has no inner */
+
+      inner = calloc(1, sizeof(*inner));
+      if (inner == NULL)
+        goto failure;
+
+      intarr->inner = inner;
+
+      inner->nused      = exprnode->u.ints.count;
+      inner->nallocated = exprnode->u.ints.count;
+      inner->ints       = ast->ints + exprnode->u.ints.first;
+    }
+    break;
+
+  case ZTEXPR_SCOPEARRAY:
+    {
+      ztast_scopearray_t      *scopearr;
+      ztast_scopearrayinner_t *inner;
+      ztast_index_t            index;
+
+      scopearr = calloc(1, sizeof(*scopearr));
+      if (scopearr == NULL)
+        goto failure;
+
+      expr->data.scopearray = scopearr;
+
+      inner = calloc(1, sizeof(*inner));
+      if (inner == NULL)
+        goto failure;
+
+      scopearr->inner = inner;
+
+      inner->scopes = calloc(exprnode->u.scopes.count, sizeof(*inner->scopes));
+      if (inner->scopes == NULL)
+        goto failure;
 
-    inner->nused      = 0;
-    inner->nallocated = 0;
-    inner->scopes     = NULL;
+      inner->nallocated = exprnode->u.scopes.count;
+
+      for (index = exprnode->u.scopes.first; index; index = ZTAST_NODE(ast, index)->next)
+      {
+        ztast_scope_t *scope;
+
+        scope = calloc(1, sizeof(*scope));
+        if (scope == NULL)
+          goto failure;
+
+        inner->scopes[inner->nused++] = scope;
+
+        if (!ztast_view_statements(ast,
+                                   ZTAST_NODE(ast, index)->expr.u.statements,
+                                  &scope->statements))
+          goto failure;
+      }
+    }
+    break;
   }
 
-  if (inner->nused == inner->nallocated)
-  {
-    int             newarrlen;
-    ztast_scope_t **newarr;
+  return expr;
 
-    /* This code pattern would use realloc() normally but our simple memory
-     * manager doesn't currently feature it. */
 
-    newarrlen = inner->nallocated < 8 ? 8 : inner->nallocated * 2;
-    newarr = ZTAST_MALLOC(newarrlen * sizeof(*newarr));
-    if (newarr == NULL)
-      return NULL;
- 
-    memcpy(newarr, inner->scopes, inner->nallocated * sizeof(*newarr));
-    ZTAST_FREE(inner->scopes);
+failure:
+  ztast_view_expr_destroy(expr);
+
+  return NULL;
+}
+
+ztast_program_t *ztast_view_program(const ztast_t *ast)
+{
+  ztast_program_t *program;
+
+  assert(ast);
+  assert(ast->haveprogram);
 
-    inner->nallocated = newarrlen;
-    inner->scopes     = newarr;
+  program = calloc(1, sizeof(*program));
+  if (program == NULL)
+    return NULL;
+
+  if (!ztast_view_statements(ast, ast->program, &program->statements))
+  {
+    ztast_view_program_destroy(program);
+    return NULL;
   }
 
-  inner->scopes[inner->nused++] = scope;
+  return program;
+}
+
+void ztast_view_program_destroy(ztast_program_t *program)
+{
+  if (program == NULL)
+    return;
 
-  return inner;
+  ztast_view_statements_destroy(program->statements);
+  free(program);
 }
 
 /* ----------------------------------------------------------------------- */
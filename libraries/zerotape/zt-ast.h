@@ -11,6 +11,8 @@
 
 typedef void *(ztast_mallocfn_t)(size_t, void *opaque);
 typedef void (ztast_freefn_t)(void *, void *opaque);
+typedef void *(ztast_reallocfn_t)(void *, size_t, void *opaque);
+typedef void (ztast_releasefn_t)(void *opaque);
 
 typedef void (ztast_logfn_t)(const char *fmt, ...);
 
@@ -18,69 +20,177 @@ typedef void (ztast_logfn_t)(const char *fmt, ...);
 
 typedef struct ztast ztast_t;
 
+/* 'reallocfn' may be NULL, in which case blocks are moved to grow them.
+ * 'releasefn' may be NULL. If given, it's called on 'opaque' to release
+ * all of the AST's memory at once when the AST is destroyed. */
 ztast_t *ztast_create(ztast_mallocfn_t  *mallocfn,
                       ztast_freefn_t    *freefn,
+                      ztast_reallocfn_t *reallocfn,
+                      ztast_releasefn_t *releasefn,
                       void              *opaque,
                       ztast_logfn_t     *logfn);
 void ztast_destroy(ztast_t *ast);
 
 /* ----------------------------------------------------------------------- */
 
+/* The AST is held compactly in pools: one array of nodes, one of integers
+ * and one of identifier strings. Nodes refer to one another by index, so
+ * a scalar assignment costs a single node. The public ztast_* structures
+ * are built on demand as views over the pools. */
+
+/* Index of a node in the node pool. Node zero is never allocated so zero
+ * means "none". */
+typedef unsigned int ztast_index_t;
+
+/* A slice of the integer pool. */
+typedef struct ztast_intslice
+{
+  unsigned int first;
+  unsigned int count;
+}
+ztast_intslice_t;
+
+/* An expression, held inline in the node which uses it. */
+typedef struct ztast_exprnode
+{
+  unsigned char type;      /* enum ztast_expr_type */
+  unsigned char valuetype; /* enum ztast_value_type, for ZTEXPR_VALUE */
+  union ztast_exprnode_data
+  {
+    int              integer;    /* ZTVAL_INTEGER */
+    int              decimal;    /* ZTVAL_DECIMAL */
+    ztast_index_t    statements; /* ZTEXPR_SCOPE: first statement, or zero */
+    ztast_intslice_t ints;       /* ZTEXPR_INTARRAY */
+    struct
+    {
+      ztast_index_t  first;      /* first scope node */
+      unsigned int   count;
+    }
+    scopes;                      /* ZTEXPR_SCOPEARRAY */
+  }
+  u;
+}
+ztast_exprnode_t;
+
+/* A node is either an assignment in a statement list, or a scope in a
+ * scope array. Statements and scopes are linked in order through 'next'. */
+typedef struct ztast_node
+{
+  ztast_index_t    next; /* or zero */
+  unsigned int     name; /* assignments: offset of the id in the string pool */
+  ztast_exprnode_t expr; /* assignments: the value; scopes: its statements */
+}
+ztast_node_t;
+
+/* A list of nodes under construction. The tail is kept so that appending
+ * is constant time. */
+typedef struct ztast_list
+{
+  ztast_index_t head;
+  ztast_index_t tail;
+  unsigned int  count;
+}
+ztast_list_t;
+
+/* ----------------------------------------------------------------------- */
+
 struct ztast
 {
-  /* root node */
-  ztast_program_t   *program;
+  /* root: the first top-level statement */
+  ztast_index_t      program;
+  int                haveprogram;
+
+  /* node pool */
+  ztast_node_t      *nodes;
+  ztast_index_t      nnodes;
+  ztast_index_t      nodesallocated;
+
+  /* integer pool: each integer array occupies a contiguous slice */
+  unsigned int      *ints;
+  unsigned int       nints;
+  unsigned int       intsallocated;
+
+  /* string pool: terminated identifiers, each stored once */
+  char              *strings;
+  unsigned int       nstrings;
+  unsigned int       stringsallocated;
+
+  /* interned identifiers: an open addressed hash table of string offsets */
+  unsigned int      *ids;
+  int                nids;
+  int                idsallocated; /* power of two, or zero */
+
+  int                oom; /* an allocation failed while building */
 
   /* virtual functions */
   ztast_mallocfn_t  *mallocfn;
   ztast_freefn_t    *freefn;
+  ztast_reallocfn_t *reallocfn;
+  ztast_releasefn_t *releasefn;
   void              *opaque;
-  
+
 #ifdef ZTAST_LOG
   ztast_logfn_t     *logfn;
 #endif
 };
 
+#define ZTAST_NODE(AST, INDEX) (&(AST)->nodes[INDEX])
+#define ZTAST_NAME(AST, NODE)  ((AST)->strings + (NODE)->name)
+
 /* ----------------------------------------------------------------------- */
 
-ztast_program_t *ztast_program(ztast_t *ast, ztast_statement_t *statement);
+void ztast_program(ztast_t *ast, ztast_index_t statements);
 
-void ztast_statement_append(ztast_t           *ast,
-                            ztast_statement_t *statementlist,
-                            ztast_statement_t *appendee);
-ztast_statement_t *ztast_statement_from_assignment(ztast_t            *ast,
-                                                   ztast_assignment_t *ass);
+void ztast_statement_append(ztast_t       *ast,
+                            ztast_list_t  *statementlist,
+                            ztast_index_t  appendee);
 
-ztast_assignment_t *ztast_assignment(ztast_t      *ast,
-                                     ztast_id_t   *id,
-                                     ztast_expr_t *expr);
+/* Returns the new node, or zero if out of memory. */
+ztast_index_t ztast_assignment(ztast_t          *ast,
+                               unsigned int      name,
+                         const ztast_exprnode_t *expr);
 
-ztast_id_t *ztast_id(ztast_t *ast, const char *name);
+/* 'name' need not be terminated. Identical names share an offset.
+ * Returns the name's offset in the string pool, or zero if out of memory. */
+unsigned int ztast_id(ztast_t *ast, const char *name, size_t length);
 
-ztast_value_t *ztast_value_from_integer(ztast_t *ast, int integer);
-ztast_value_t *ztast_value_from_decimal(ztast_t *ast, int decimal);
-ztast_value_t *ztast_value_nil(ztast_t *ast);
+ztast_exprnode_t ztast_expr_from_integer(ztast_t *ast, int integer);
+ztast_exprnode_t ztast_expr_from_decimal(ztast_t *ast, int decimal);
+ztast_exprnode_t ztast_expr_nil(ztast_t *ast);
+ztast_exprnode_t ztast_expr_from_scope(ztast_t *ast, ztast_index_t statements);
 
-ztast_expr_t *ztast_expr_from_value(ztast_t *ast, ztast_value_t *value);
-ztast_expr_t *ztast_expr_from_scope(ztast_t *ast, ztast_scope_t *scope);
-ztast_expr_t *ztast_expr_from_intarray(ztast_t *ast, ztast_intarray_t *array);
-ztast_expr_t *ztast_expr_from_scopearray(ztast_t *ast, ztast_scopearray_t *scope);
+/* 'inner' may be NULL for an empty array */
+ztast_exprnode_t ztast_expr_from_intarray(ztast_t          *ast,
+                                    const ztast_intslice_t *inner);
+ztast_exprnode_t ztast_expr_from_scopearray(ztast_t      *ast,
+                                      const ztast_list_t *inner);
 
-ztast_scope_t *ztast_scope(ztast_t *ast, ztast_statement_t *statement);
+/* call with (inner == NULL) to create */
+ztast_intslice_t ztast_intarrayinner_append(ztast_t          *ast,
+                                      const ztast_intslice_t *inner,
+                                            int               value);
 
-ztast_intarray_t *ztast_intarray(ztast_t *ast, ztast_intarrayinner_t *elem);
+/* call with (inner == NULL) to create */
+ztast_intslice_t ztast_intarrayinner_append_run(ztast_t          *ast,
+                                          const ztast_intslice_t *inner,
+                                          const unsigned int     *values,
+                                                int               nvalues);
 
 /* call with (inner == NULL) to create */
-ztast_intarrayinner_t *ztast_intarrayinner_append(ztast_t               *ast,
-                                                  ztast_intarrayinner_t *inner,
-                                                  int                    value);
+ztast_list_t ztast_scopearrayinner_append(ztast_t       *ast,
+                                    const ztast_list_t  *inner,
+                                          ztast_index_t  statements);
 
-ztast_scopearray_t *ztast_scopearray(ztast_t *ast, ztast_scopearrayinner_t *elem);
+/* ----------------------------------------------------------------------- */
 
-/* call with (inner == NULL) to create */
-ztast_scopearrayinner_t *ztast_scopearrayinner_append(ztast_t                 *ast,
-                                                      ztast_scopearrayinner_t *inner,
-                                                      ztast_scope_t           *scope);
+/* Build a view of 'expr' using the public structures, for callers such as
+ * custom loaders. Returns NULL if out of memory. */
+ztast_expr_t *ztast_view_expr(const ztast_t *ast, const ztast_exprnode_t *expr);
+void ztast_view_expr_destroy(ztast_expr_t *view);
+
+/* As above, for the whole program. */
+ztast_program_t *ztast_view_program(const ztast_t *ast);
+void ztast_view_program_destroy(ztast_program_t *view);
 
 /* ----------------------------------------------------------------------- */
 
@@ -16,6 +16,7 @@
 #include "zt-gram.h"
 #include "zt-driver.h"
 #include "zt-gramx.h"
+#include "zt-run.h"
 
 #include "zt-lex-test.h"
 
@@ -60,63 +61,317 @@ static void ztparser_log(const char *fmt, ...)
 
 /* ----------------------------------------------------------------------- */
 
-ztast_t *ztast_from_file(const char *filename, char errbuf[ZTMAXERRBUF])
+struct ztparser
 {
-  ztlex_t          *lexer;
-  ztparseinfo_t     parseinfo;
-  void             *parser;
-  ztslaballoc_t    *slaballoc;
-  ztast_t          *ast;
-  ztlextok_t        token;
-  const ztlexinf_t *info;
+  ztlex_t       *lexer;
+  void          *parser; /* Lemon parser */
+  ztslaballoc_t *slaballoc;
+  ztast_t       *ast;
+  ztparseinfo_t  parseinfo;
+  int            ended; /* the end of input has been given to the parser */
+  char           errbuf[ZTMAXERRBUF];
+};
 
-  errbuf[0] = '\0';
+/* Create a parsing context around 'lexer'. The lexer is destroyed on
+ * failure. 'releasefn' is given to the AST (see ztast_create). */
+static ztparser_t *ztparser_create_for(ztlex_t           *lexer,
+                                       ztast_releasefn_t *releasefn)
+{
+  ztparser_t *ctx;
 
-  /* Build a lexer */
-  lexer = ztlex_from_file(lexer_malloc, lexer_free, filename);
   if (lexer == NULL)
     return NULL;
 
+  ctx = malloc(sizeof(*ctx));
+  if (ctx == NULL)
+    goto failure;
+
+  ctx->lexer     = lexer;
+  ctx->parser    = NULL;
+  ctx->slaballoc = NULL;
+  ctx->ended     = 0;
+  ctx->errbuf[0] = '\0';
+
   /* Allocate a parser */
-  parser = ztparseAlloc(parser_malloc, &parseinfo);
+  ctx->parser = ztparseAlloc(parser_malloc, &ctx->parseinfo);
+  if (ctx->parser == NULL)
+    goto failure;
 
   /* Create a memory allocator */
-  slaballoc = ztslaballoc_create();
-  if (slaballoc == NULL)
-  {
-    ztparseFree(parser, parser_free);
-    return NULL;
-  }
+  ctx->slaballoc = ztslaballoc_create(0);
+  if (ctx->slaballoc == NULL)
+    goto failure;
 
   /* Create an AST */
-  ast = ztast_create(ztslaballoc, ztslabfree, slaballoc, ztparser_log);
-  if (ast == NULL)
-    goto stop;
+  ctx->ast = ztast_create(ztslaballoc, ztslabfree, ztslabrealloc,
+                          releasefn, ctx->slaballoc, ztparser_log);
+  if (ctx->ast == NULL)
+    goto failure;
 
   /* Setup parser */
-  parseinfo.ast    = ast;
-  parseinfo.errbuf = errbuf;
+  ctx->parseinfo.ast    = ctx->ast;
+  ctx->parseinfo.lexer  = lexer;
+  ctx->parseinfo.errbuf = ctx->errbuf;
+  ctx->parseinfo.stream = NULL;
 
   /* Uncomment to enable parser debug output */
   /* ztparseTrace(stderr, "ztparse: "); */
 
-  /* Feed the parser one token at a time */
-  while (ztlex_next_token(lexer, &token, &info))
+  return ctx;
+
+
+failure:
+  if (ctx)
+  {
+    ztslaballoc_destroy(ctx->slaballoc);
+    if (ctx->parser)
+      ztparseFree(ctx->parser, parser_free);
+    free(ctx);
+  }
+  ztlex_destroy(lexer);
+
+  return NULL;
+}
+
+/* Feed the parser tokens until the lexer runs dry. */
+static void ztparser_pump(ztparser_t *ctx)
+{
+  ztlextok_t        tokens[ZTLEX_MAXBATCH];
+  const ztlexinf_t *infos[ZTLEX_MAXBATCH];
+  int               n;
+
+  /* Feed the parser a batch of tokens at a time */
+  while (!ctx->ended && ctx->errbuf[0] == '\0')
   {
-    ztparse(parser, token, (ztlexinf_t *) info); /* cast away const for interface */
-    if (parseinfo.errbuf[0])
-      goto stop;
+    n = ztlex_next_tokens(ctx->lexer, tokens, infos, ZTLEX_MAXBATCH);
+    if (n == 0)
+    {
+      if (ztlex_starved(ctx->lexer))
+        return; /* wait for more input */
+
+      ztparse(ctx->parser, 0, NULL);
+      ctx->ended = 1;
+      return;
+    }
+
+    /* cast away const for interface */
+    ztparseBatch(ctx->parser, tokens, (ztlexinf_t * const *) infos, n);
   }
-  ztparse(parser, 0, (ztlexinf_t *) info);
+}
+
+/* Finish up and destroy 'ctx'. Returns the AST, or NULL on error. */
+static ztast_t *ztparser_end(ztparser_t *ctx, char errbuf[ZTMAXERRBUF])
+{
+  ztast_t *ast;
+
+  if (ctx->ast->oom && ctx->errbuf[0] == '\0')
+    strcpy(ctx->errbuf, "out of memory");
 
-stop:
-  ztparseFree(parser, parser_free);
 #ifdef ZT_DEBUG
-  ztslaballoc_spew(slaballoc);
+  ztslaballoc_spew(ctx->slaballoc);
 #endif
-  ztlex_destroy(lexer);
 
-  return (parseinfo.errbuf[0] == '\0') ? ast : NULL;
+  memcpy(errbuf, ctx->errbuf, ZTMAXERRBUF);
+  if (ctx->errbuf[0] == '\0')
+  {
+    ast = ctx->ast;
+  }
+  else
+  {
+    ast = NULL;
+    ztast_destroy(ctx->ast);
+  }
+
+  ztparseFree(ctx->parser, parser_free);
+  ztlex_destroy(ctx->lexer);
+  free(ctx);
+
+  return ast;
+}
+
+/* ----------------------------------------------------------------------- */
+
+/* Parse all of the input to 'lexer' (NULL if it couldn't be created). */
+static ztast_t *ztast_from_lexer(ztlex_t *lexer, char errbuf[ZTMAXERRBUF])
+{
+  ztparser_t *ctx;
+
+  errbuf[0] = '\0';
+
+  ctx = ztparser_create_for(lexer, ztslabrelease);
+  if (ctx == NULL)
+    return NULL;
+
+  ztparser_pump(ctx);
+
+  return ztparser_end(ctx, errbuf);
+}
+
+ztast_t *ztast_from_file(const char *filename, char errbuf[ZTMAXERRBUF])
+{
+  return ztast_from_lexer(ztlex_from_file(lexer_malloc, lexer_free, filename),
+                          errbuf);
+}
+
+ztast_t *ztast_from_buffer(const char *data,
+                           size_t      length,
+                           char        errbuf[ZTMAXERRBUF])
+{
+  return ztast_from_lexer(ztlex_from_buffer(lexer_malloc, lexer_free,
+                                            data, length),
+                          errbuf);
+}
+
+int ztparser_stream_file(const char *filename,
+                         ztstream_t *stream,
+                         char        errbuf[ZTMAXERRBUF])
+{
+  ztparser_t *ctx;
+  ztast_t    *ast;
+
+  errbuf[0] = '\0';
+
+  ctx = ztparser_create_for(ztlex_from_file(lexer_malloc, lexer_free, filename),
+                            ztslabrelease);
+  if (ctx == NULL)
+    return 0;
+
+  /* the stream reports its errors through the parser so that parsing
+   * stops at the first */
+  ctx->parseinfo.stream = stream;
+  stream->ast           = ctx->ast;
+  stream->exec.ast      = ctx->ast;
+  stream->exec.errbuf   = ctx->errbuf;
+
+  ztparser_pump(ctx);
+
+  ast = ztparser_end(ctx, errbuf);
+  stream->ast         = NULL;
+  stream->exec.ast    = NULL;
+  stream->exec.errbuf = NULL;
+
+  ztast_destroy(ast);
+
+  /* a loader may fail without leaving a message, so the parse alone
+   * doesn't tell whether the load succeeded */
+  return ast != NULL && stream->rc == ztresult_OK;
+}
+
+/* ----------------------------------------------------------------------- */
+
+ztparser_t *ztparser_create_reusable(void)
+{
+  /* The AST lives in the parser's arena, which is reset rather than
+   * released, so it's given no release function. */
+  return ztparser_create_for(ztlex_for_push(lexer_malloc, lexer_free), NULL);
+}
+
+ztast_t *ztparser_parse_file(ztparser_t *ctx,
+                             const char *filename,
+                             char        errbuf[ZTMAXERRBUF])
+{
+  assert(ctx);
+  assert(filename);
+
+  errbuf[0] = '\0';
+
+  /* Return the parser to its initial state and free the previous AST, and
+   * everything else in the arena, at once */
+  ztparseFinalize(ctx->parser);
+  ztparseInit(ctx->parser, &ctx->parseinfo);
+  ztslaballoc_reset(ctx->slaballoc);
+
+  ctx->ended     = 0;
+  ctx->errbuf[0] = '\0';
+
+  ctx->ast = ztast_create(ztslaballoc, ztslabfree, ztslabrealloc,
+                          NULL, ctx->slaballoc, ztparser_log);
+  ctx->parseinfo.ast = ctx->ast;
+  if (ctx->ast == NULL)
+    return NULL;
+
+  if (!ztlex_open(ctx->lexer, filename))
+    return NULL;
+
+  ztparser_pump(ctx);
+
+  ztlex_close(ctx->lexer);
+
+  if (ctx->ast->oom && ctx->errbuf[0] == '\0')
+    strcpy(ctx->errbuf, "out of memory");
+
+#ifdef ZT_DEBUG
+  ztslaballoc_spew(ctx->slaballoc);
+#endif
+
+  memcpy(errbuf, ctx->errbuf, ZTMAXERRBUF);
+
+  return (ctx->errbuf[0] == '\0') ? ctx->ast : NULL;
+}
+
+void ztparser_delete(ztparser_t *ctx)
+{
+  if (ctx == NULL)
+    return;
+
+  ztparseFree(ctx->parser, parser_free);
+  ztslaballoc_destroy(ctx->slaballoc);
+  ztlex_destroy(ctx->lexer);
+  free(ctx);
+}
+
+/* ----------------------------------------------------------------------- */
+
+ztparser_t *ztparser_create(void)
+{
+  return ztparser_create_for(ztlex_for_push(lexer_malloc, lexer_free),
+                             ztslabrelease);
+}
+
+ztresult_t ztparser_feed(ztparser_t *ctx, const void *bytes, size_t n)
+{
+  const char *p = bytes;
+
+  assert(ctx);
+  assert(bytes || n == 0);
+
+  /* The lexer's buffer is of fixed size so we pass the input through in
+   * pieces, tokenising each piece before accepting more. */
+  while (n > 0 && !ctx->ended && ctx->errbuf[0] == '\0')
+  {
+    size_t accepted;
+
+    accepted = ztlex_feed(ctx->lexer, p, n);
+    assert(accepted > 0); /* a pending token can't fill the buffer */
+    p += accepted;
+    n -= accepted;
+
+    ztparser_pump(ctx);
+  }
+
+  return (ctx->errbuf[0] == '\0') ? ztresult_OK : ztresult_PARSE_FAIL;
+}
+
+void ztparser_destroy(ztparser_t *ctx)
+{
+  if (ctx == NULL)
+    return;
+
+  /* the AST owns the parser's arena, so this releases that too */
+  ztast_destroy(ctx->ast);
+  ztparseFree(ctx->parser, parser_free);
+  ztlex_destroy(ctx->lexer);
+  free(ctx);
+}
+
+ztast_t *ztast_from_parser(ztparser_t *ctx, char errbuf[ZTMAXERRBUF])
+{
+  assert(ctx);
+
+  ztlex_finish(ctx->lexer);
+  ztparser_pump(ctx);
+
+  return ztparser_end(ctx, errbuf);
 }
 
 /* ----------------------------------------------------------------------- */
@@ -14,10 +14,14 @@
 
 /* ----------------------------------------------------------------------- */
 
+struct ztstream;
+
 typedef struct ztparseinfo
 {
-  ztast_t *ast;
-  char    *errbuf;
+  ztast_t         *ast;
+  ztlex_t         *lexer;  /* for locating errors */
+  char            *errbuf;
+  struct ztstream *stream; /* streaming loads only, else NULL */
 }
 ztparseinfo_t;
 
@@ -25,6 +29,32 @@ ztparseinfo_t;
 
 ztast_t *ztast_from_file(const char *filename, char errbuf[ZTMAXERRBUF]);
 
+/* 'data' needn't be terminated. It's parsed in place, so it must remain
+ * valid until the AST is destroyed. */
+ztast_t *ztast_from_buffer(const char *data,
+                           size_t      length,
+                           char        errbuf[ZTMAXERRBUF]);
+
+/* Ends the input given to a push parser, then destroys it. */
+ztast_t *ztast_from_parser(ztparser_t *ctx, char errbuf[ZTMAXERRBUF]);
+
+/* A reusable parser parses whole files, one after another, keeping its
+ * lexer buffers, Lemon parser and arena between them. */
+ztparser_t *ztparser_create_reusable(void);
+/* The AST remains owned by the parser. It's valid until the next call, or
+ * until the parser is deleted, and mustn't be destroyed by the caller. */
+ztast_t *ztparser_parse_file(ztparser_t *ctx,
+                             const char *filename,
+                             char        errbuf[ZTMAXERRBUF]);
+void ztparser_delete(ztparser_t *ctx);
+
+/* Parse a file as a streaming load (see zt-run.h). Returns non-zero if
+ * both the parse and the load succeeded; otherwise stream->rc holds the
+ * load's error, if it had one. */
+int ztparser_stream_file(const char      *filename,
+                         struct ztstream *stream,
+                         char             errbuf[ZTMAXERRBUF]);
+
 /* ----------------------------------------------------------------------- */
 
 #endif /* ZT_DRIVER_H */
@@ -5,7 +5,7 @@
 //
 
 // TODO: Store the lexeme location in the AST?
-//{ printf("p: [%d,%d] %s\n", I->line, I->column, I->lexeme); }
+//{ printf("p: [%lu] %.*s\n", (unsigned long) I->offset, I->length, I->lexeme); }
 
 %token_prefix ZTTOKEN_
 
@@ -16,14 +16,25 @@
 %extra_context { ztparseinfo_t *info }
 
 %syntax_error {
+  /* tokens arrive in batches, so keep only the first error */
+  if (info->errbuf[0] != '\0')
+    return;
+
   if (TOKEN)
-    sprintf(info->errbuf, "syntax error at line %d column %d", TOKEN->line, TOKEN->column);
+  {
+    int line, column;
+
+    /* only now do we work out where the token is */
+    ztlex_location(info->lexer, TOKEN->offset, &line, &column);
+    sprintf(info->errbuf, "syntax error at line %d column %d", line, column);
+  }
   else
     sprintf(info->errbuf, "syntax error");
 }
 
 %stack_overflow {
-  sprintf(info->errbuf, "parser stack overflow");
+  if (info->errbuf[0] == '\0')
+    sprintf(info->errbuf, "parser stack overflow");
 }
 
 %name ztparse
@@ -40,40 +51,43 @@
 #include "zt-driver.h"
 #include "zt-gramx.h"
 #include "zt-lex.h"
+#include "zt-run.h"
 }
 
 %left PLUS MINUS.
 %left TIMES DIVIDE.
 
-%type program { ztast_program_t * }
-program(A)      ::= .                 { A = ztast_program(info->ast, NULL); }
-program(A)      ::= statementlist(B). { A = ztast_program(info->ast, B); }
+program         ::= .                 { ztast_program(info->ast, 0); }
+program         ::= statementlist(B). { ztast_program(info->ast, B.head); }
 
-%type statementlist { ztast_statement_t * }
-statementlist(A)  ::= statementlist(A) statement(B). { ztast_statement_append(info->ast, A, B); }
-statementlist     ::= statement.
+%type statementlist { ztast_list_t }
+statementlist(A)  ::= statementlist(A) statement(B). { if (B) ztast_statement_append(info->ast, &A, B); }
+statementlist(A)  ::= statement(B).                  { A.head = A.tail = B; A.count = 1; }
 
-%type statement { ztast_statement_t * }
-statement(A)    ::= assignment(B). { A = ztast_statement_from_assignment(info->ast, B); }
+%type statement { ztast_index_t }
+statement       ::= assignment.
 
-%type assignment { ztast_assignment_t * }
-assignment(A)   ::= id(B) EQUALS expr(C) SEMICOLON. { A = ztast_assignment(info->ast, B, C); }
+%type assignment { ztast_index_t }
+assignment(A)   ::= id(B) EQUALS expr(C) SEMICOLON. { A = info->stream ? zt_stream_assignment(info->stream, B, &C) : ztast_assignment(info->ast, B, &C); }
 
-%type id { ztast_id_t * }
-id(A)           ::= NAME(B). { A = ztast_id(info->ast, B->lexeme); }
+// In a streaming load (see zt-run.h) the field is resolved here, before
+// any of the expression assigned to it has been reduced. Statements which
+// were loaded like this leave no node in the AST.
+%type id { unsigned int }
+id(A)           ::= NAME(B). { A = info->stream ? zt_stream_field(info->stream, B->lexeme, B->length) : ztast_id(info->ast, B->lexeme, B->length); }
 
 // While we allow expressions to be values, we don't allow them to be arrays of
 // values, just arrays of int, scope, or a single scope.
-%type expr { ztast_expr_t * }
-expr(A)         ::= value(B).      { A = ztast_expr_from_value(info->ast, B); }
+%type expr { ztast_exprnode_t }
+expr            ::= value.
 expr(A)         ::= scope(B).      { A = ztast_expr_from_scope(info->ast, B); }
-expr(A)         ::= intarray(B).   { A = ztast_expr_from_intarray(info->ast, B); }
-expr(A)         ::= scopearray(B). { A = ztast_expr_from_scopearray(info->ast, B); }
+expr            ::= intarray.
+expr            ::= scopearray.
 
-%type value { ztast_value_t * }
-value(A)        ::= term(B).    { A = ztast_value_from_integer(info->ast, B); }
-value(A)        ::= decimal(B). { A = ztast_value_from_decimal(info->ast, B); }
-value(A)        ::= NIL.        { A = ztast_value_nil(info->ast); }
+%type value { ztast_exprnode_t }
+value(A)        ::= term(B).    { A = ztast_expr_from_integer(info->ast, B); }
+value(A)        ::= decimal(B). { A = ztast_expr_from_decimal(info->ast, B); }
+value(A)        ::= NIL.        { A = ztast_expr_nil(info->ast); }
 
 %type term { int }
 term(A)         ::= term(B) PLUS term(C).   { A = B + C; }
@@ -84,28 +98,36 @@ term(A)         ::= LPAREN term(E) RPAREN.  { A = E; }
 term            ::= integer.
 
 %type integer { int }
-integer(A)      ::= INT(B).       { A = atoi(B->lexeme); }
-integer(A)      ::= DOLLARHEX(B). { A = (int) strtol(B->lexeme + 1, NULL, 16); } // skip $
-integer(A)      ::= HEX(B).       { A = (int) strtol(B->lexeme + 2, NULL, 16); } // skip 0x
+// The lexer decodes numbers as it scans them
+integer(A)      ::= INT(B).       { A = (int) B->value; }
+integer(A)      ::= DOLLARHEX(B). { A = (int) B->value; }
+integer(A)      ::= HEX(B).       { A = (int) B->value; }
 
 %type decimal { int }
-decimal(A)      ::= DECIMAL(B).   { A = (int)(atof(B->lexeme) * 100); }
+decimal(A)      ::= DECIMAL(B).   { A = (int) B->value; } // fixed point x100
+
+%type scope { ztast_index_t }
+scope(A)        ::= scopeopen RBRACE.                  { A = 0; if (info->stream) zt_stream_scope_close(info->stream); }
+scope(A)        ::= scopeopen statementlist(B) RBRACE. { A = B.head; if (info->stream) zt_stream_scope_close(info->stream); }
 
-%type scope { ztast_scope_t * }
-scope(A)        ::= LBRACE RBRACE.                  { A = ztast_scope(info->ast, NULL); }
-scope(A)        ::= LBRACE statementlist(B) RBRACE. { A = ztast_scope(info->ast, B); }
+// Openings are reduced as soon as the following token arrives, so before
+// anything within the scope or array
+scopeopen       ::= LBRACE. { if (info->stream) zt_stream_scope_open(info->stream); }
+arrayopen       ::= LSQBRA. { if (info->stream) zt_stream_array_open(info->stream); }
 
-%type intarray { ztast_intarray_t * }
-intarray(A)     ::= LSQBRA RSQBRA.                  { A = ztast_intarray(info->ast, NULL); }
-intarray(A)     ::= LSQBRA intarrayinner(B) RSQBRA. { A = ztast_intarray(info->ast, B); }
+%type intarray { ztast_exprnode_t }
+intarray(A)     ::= arrayopen RSQBRA.                  { A = ztast_expr_from_intarray(info->ast, NULL); }
+intarray(A)     ::= arrayopen intarrayinner(B) RSQBRA. { A = ztast_expr_from_intarray(info->ast, &B); }
 
-%type intarrayinner { ztast_intarrayinner_t * }
-intarrayinner(A) ::= term(B). { A = ztast_intarrayinner_append(info->ast, NULL, B); }
-intarrayinner(A) ::= intarrayinner(A) COMMA term(B). { A = ztast_intarrayinner_append(info->ast, A, B); }
+%type intarrayinner { ztast_intslice_t }
+intarrayinner(A) ::= term(B). { unsigned int v = B; A = info->stream ? zt_stream_ints(info->stream, NULL, &v, 1) : ztast_intarrayinner_append(info->ast, NULL, B); }
+intarrayinner(A) ::= INTRUN(B). { A = info->stream ? zt_stream_ints(info->stream, NULL, B->run, B->nrun) : ztast_intarrayinner_append_run(info->ast, NULL, B->run, B->nrun); }
+intarrayinner(A) ::= intarrayinner(A) COMMA term(B). { unsigned int v = B; A = info->stream ? zt_stream_ints(info->stream, &A, &v, 1) : ztast_intarrayinner_append(info->ast, &A, B); }
+intarrayinner(A) ::= intarrayinner(A) COMMA INTRUN(B). { A = info->stream ? zt_stream_ints(info->stream, &A, B->run, B->nrun) : ztast_intarrayinner_append_run(info->ast, &A, B->run, B->nrun); }
 
-%type scopearray { ztast_scopearray_t * }
-scopearray(A)   ::= LSQBRA scopearrayinner(B) RSQBRA. { A = ztast_scopearray(info->ast, B); }
+%type scopearray { ztast_exprnode_t }
+scopearray(A)   ::= arrayopen scopearrayinner(B) RSQBRA. { A = ztast_expr_from_scopearray(info->ast, &B); }
 
-%type scopearrayinner { ztast_scopearrayinner_t * }
-scopearrayinner(A) ::= scope(B). { A = ztast_scopearrayinner_append(info->ast, NULL, B); }
-scopearrayinner(A) ::= scopearrayinner(A) COMMA scope(B). { A = ztast_scopearrayinner_append(info->ast, A, B); }
+%type scopearrayinner { ztast_list_t }
+scopearrayinner(A) ::= scope(B). { A = info->stream ? zt_stream_scopes(info->stream, NULL, B) : ztast_scopearrayinner_append(info->ast, NULL, B); }
+scopearrayinner(A) ::= scopearrayinner(A) COMMA scope(B). { A = info->stream ? zt_stream_scopes(info->stream, &A, B) : ztast_scopearrayinner_append(info->ast, &A, B); }
@@ -15,6 +15,7 @@ void *ztparseAlloc(void *(*mallocProc)(size_t), ztparseinfo_t *info);
 void ztparseFinalize(void *p);
 void ztparseFree(void *p, void (*freeProc)(void *));
 void ztparse(void *yyp, int yymajor, ztlexinf_t *yyminor);
+void ztparseBatch(void *yyp, const int *yymajors, ztlexinf_t * const *yyminors, int nToken);
 int ztparseFallback(int iToken);
 
 #endif /* ZT_GRAMX_H */
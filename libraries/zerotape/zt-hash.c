@@ -0,0 +1,46 @@
+/* zt-hash.c
+ *
+ * Hashing for the library's open addressed tables.
+ */
+
+#include <stddef.h>
+
+#include "zt-hash.h"
+
+/* ----------------------------------------------------------------------- */
+
+/* FNV-1a */
+unsigned int zt_hash_string(const char *name, size_t length)
+{
+  unsigned int h;
+
+  h = 2166136261u;
+  while (length--)
+    h = (h ^ (unsigned char) *name++) * 16777619u;
+
+  return h;
+}
+
+unsigned int zt_hash_pointer(const void *p)
+{
+  size_t       v = (size_t) p;
+  unsigned int h;
+
+  h = (unsigned int) (v ^ (v >> 16 >> 16));
+
+  /* Multiplying alone would leave each low bit of the hash depending only
+   * on the address bits at or below it, and tables index by the low bits, so
+   * regularly spaced pointers would share a few slots. This finaliser
+   * (MurmurHash3's fmix32) makes every bit depend on every other. */
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+
+  return h;
+}
+
+/* ----------------------------------------------------------------------- */
+
+/* vim: set ts=8 sts=2 sw=2 et: */
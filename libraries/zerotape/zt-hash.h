@@ -0,0 +1,37 @@
+/* zt-hash.h
+ *
+ * Hashing for the library's open addressed tables.
+ */
+
+#ifndef ZT_HASH_H
+#define ZT_HASH_H
+
+#include <stddef.h>
+
+/* Whether inserting one more entry into a table of 'size' slots, 'n' of
+ * which are in use, would leave it over three quarters full. */
+#define ZTHASH_FULL(n, size) (((n) + 1) * 4 > (size) * 3)
+
+/**
+ * Hash a name.
+ *
+ * \param name name to hash - need not be terminated
+ * \param length length of 'name'
+ *
+ * \return hash of 'name'
+ */
+unsigned int zt_hash_string(const char *name, size_t length);
+
+/**
+ * Hash a pointer.
+ *
+ * \param p pointer to hash
+ *
+ * \return hash of 'p' - every bit depends on the whole address, so it can
+ * be masked to index a power of two sized table
+ */
+unsigned int zt_hash_pointer(const void *p);
+
+#endif /* ZT_HASH_H */
+
+/* vim: set ts=8 sts=2 sw=2 et: */
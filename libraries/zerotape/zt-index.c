@@ -0,0 +1,270 @@
+/* zt-index.c
+ *
+ * Field lookup indexes.
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "zerotape/zerotape.h"
+
+#include "zt-hash.h"
+
+#include "zt-index.h"
+
+/* ----------------------------------------------------------------------- */
+
+/* Structures with up to this many fields are searched linearly. Comparing
+ * a few names costs less than hashing one. */
+#define ZTINDEX_MINFIELDS   (8)
+
+/* Initial number of registry entries. Must be a power of two. */
+#define ZTINDEX_MINREGISTRY (16)
+
+/* ----------------------------------------------------------------------- */
+
+typedef struct ztfieldslot
+{
+  unsigned int hash;
+  int          field; /* index into meta->fields, or -1 if empty */
+}
+ztfieldslot_t;
+
+/* An open addressed hash table of a structure's field names. */
+typedef struct ztfieldindex
+{
+  const ztstruct_t *meta;
+  unsigned int      mask;  /* number of slots - 1 */
+  ztfieldslot_t    *slots; /* or NULL if searched linearly */
+}
+ztfieldindex_t;
+
+/* Indexes built so far, keyed by the address of their metadata. */
+static struct
+{
+  ztfieldindex_t **entries;
+  unsigned int     nentries;
+  unsigned int     size;
+}
+registry;
+
+/* ----------------------------------------------------------------------- */
+
+/* Returns the registry entry for 'meta', or the empty entry where it
+ * belongs. The registry must exist. */
+static ztfieldindex_t **zt_index_entry(const ztstruct_t *meta)
+{
+  unsigned int j;
+
+  for (j = zt_hash_pointer(meta); ; j++)
+  {
+    ztfieldindex_t **entry;
+
+    entry = &registry.entries[j & (registry.size - 1)];
+    if (*entry == NULL || (*entry)->meta == meta)
+      return entry;
+  }
+}
+
+static ztfieldindex_t *zt_index_find(const ztstruct_t *meta)
+{
+  if (registry.nentries == 0)
+    return NULL;
+
+  return *zt_index_entry(meta);
+}
+
+/* Double the size of the registry (or create it). */
+static int zt_index_grow(void)
+{
+  ztfieldindex_t **oldentries;
+  unsigned int     oldsize;
+  unsigned int     i;
+
+  oldentries = registry.entries;
+  oldsize    = registry.size;
+
+  registry.size    = oldsize ? oldsize * 2 : ZTINDEX_MINREGISTRY;
+  registry.entries = calloc(registry.size, sizeof(*registry.entries));
+  if (registry.entries == NULL)
+  {
+    registry.entries = oldentries;
+    registry.size    = oldsize;
+    return 0;
+  }
+
+  for (i = 0; i < oldsize; i++)
+    if (oldentries[i])
+      *zt_index_entry(oldentries[i]->meta) = oldentries[i];
+
+  free(oldentries);
+
+  return 1;
+}
+
+static int zt_index_register(ztfieldindex_t *index)
+{
+  /* keep the registry at most three quarters full */
+  if (ZTHASH_FULL(registry.nentries, registry.size))
+    if (!zt_index_grow())
+      return 0;
+
+  *zt_index_entry(index->meta) = index;
+  registry.nentries++;
+
+  return 1;
+}
+
+static ztfieldindex_t *zt_index_build(const ztstruct_t *meta)
+{
+  ztfieldindex_t *index;
+  unsigned int    nslots;
+  int             f;
+
+  nslots = 0;
+  if (meta->nfields > ZTINDEX_MINFIELDS)
+    for (nslots = ZTINDEX_MINFIELDS * 2; nslots < (unsigned int) meta->nfields * 2; nslots *= 2)
+      ;
+
+  index = malloc(sizeof(*index) + nslots * sizeof(*index->slots));
+  if (index == NULL)
+    return NULL;
+
+  index->meta  = meta;
+  index->mask  = nslots ? nslots - 1 : 0;
+  index->slots = NULL;
+  if (nslots == 0)
+    return index;
+
+  index->slots = (ztfieldslot_t *) (index + 1);
+  for (f = 0; f < (int) nslots; f++)
+    index->slots[f].field = -1;
+
+  /* fields are inserted in order so that the first of any duplicated names
+   * is found first, as it would be by a linear search */
+  for (f = 0; f < meta->nfields; f++)
+  {
+    const char   *name = meta->fields[f].name;
+    unsigned int  hash;
+    unsigned int  j;
+
+    hash = zt_hash_string(name, strlen(name));
+    for (j = hash; index->slots[j & index->mask].field >= 0; j++)
+      ;
+    index->slots[j & index->mask].hash  = hash;
+    index->slots[j & index->mask].field = f;
+  }
+
+  return index;
+}
+
+static int zt_index_linear(const ztstruct_t *meta,
+                           const char       *name,
+                           size_t            length)
+{
+  int f;
+
+  for (f = 0; f < meta->nfields; f++)
+    if (strncmp(meta->fields[f].name, name, length) == 0 &&
+        meta->fields[f].name[length] == '\0')
+      return f;
+
+  return -1;
+}
+
+int zt_index_lookup(const ztstruct_t *meta,
+                    const char       *name,
+                    size_t            length)
+{
+  ztfieldindex_t *index;
+  unsigned int    hash;
+  unsigned int    j;
+
+  if (meta->nfields <= ZTINDEX_MINFIELDS)
+    return zt_index_linear(meta, name, length);
+
+  index = zt_index_find(meta);
+  if (index == NULL)
+  {
+    index = zt_index_build(meta);
+    if (index == NULL)
+      return zt_index_linear(meta, name, length); /* out of memory */
+    if (!zt_index_register(index))
+    {
+      free(index);
+      return zt_index_linear(meta, name, length);
+    }
+  }
+
+  hash = zt_hash_string(name, length);
+  for (j = hash; ; j++)
+  {
+    const ztfieldslot_t *slot = &index->slots[j & index->mask];
+    const char          *fieldname;
+
+    if (slot->field < 0)
+      return -1;
+    if (slot->hash != hash)
+      continue;
+    fieldname = meta->fields[slot->field].name;
+    if (strncmp(fieldname, name, length) == 0 && fieldname[length] == '\0')
+      return slot->field;
+  }
+}
+
+int zt_index_lookup_next(const ztstruct_t *meta,
+                         int               last,
+                         const char       *name,
+                         size_t            length)
+{
+  const char *fieldname;
+
+  if (last + 1 < meta->nfields)
+  {
+    fieldname = meta->fields[last + 1].name;
+    if (strncmp(fieldname, name, length) == 0 && fieldname[length] == '\0')
+      return last + 1;
+  }
+
+  return zt_index_lookup(meta, name, length);
+}
+
+/* ----------------------------------------------------------------------- */
+
+int zt_index_prepare(const ztstruct_t *meta)
+{
+  ztfieldindex_t *index;
+
+  if (meta->nfields <= ZTINDEX_MINFIELDS || zt_index_find(meta))
+    return 1;
+
+  index = zt_index_build(meta);
+  if (index == NULL)
+    return 0;
+  if (!zt_index_register(index))
+  {
+    free(index);
+    return 0;
+  }
+
+  return 1;
+}
+
+void zt_index_release(void)
+{
+  unsigned int i;
+
+  for (i = 0; i < registry.size; i++)
+    free(registry.entries[i]);
+
+  free(registry.entries);
+
+  registry.entries  = NULL;
+  registry.nentries = 0;
+  registry.size     = 0;
+}
+
+/* ----------------------------------------------------------------------- */
+
+/* vim: set ts=8 sts=2 sw=2 et: */
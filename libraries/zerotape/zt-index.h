@@ -0,0 +1,66 @@
+/* zt-index.h
+ *
+ * Field lookup indexes.
+ */
+
+#ifndef ZT_INDEX_H
+#define ZT_INDEX_H
+
+#include <stddef.h>
+
+#include "zerotape/zerotape.h"
+
+/**
+ * Find a field by name.
+ *
+ * Structures with more than a handful of fields are looked up through a
+ * hash table which is built on first use, or ahead of time by
+ * zt_index_prepare, and kept in a registry keyed by the address of 'meta'.
+ *
+ * \param meta structure to search
+ * \param name field name - need not be terminated
+ * \param length length of 'name'
+ *
+ * \return index of the field within 'meta', or -1 if not found
+ */
+int zt_index_lookup(const ztstruct_t *meta,
+                    const char       *name,
+                    size_t            length);
+
+/**
+ * Find a field by name, trying the one after 'last' first.
+ *
+ * zt_save writes fields in the order they're defined, so when loading a
+ * saved file the next assignment in a scope is usually to the field after
+ * the previous one. That costs a single compare.
+ *
+ * \param meta structure to search
+ * \param last index of the last field assigned in this scope, or -1
+ * \param name field name - need not be terminated
+ * \param length length of 'name'
+ *
+ * \return index of the field within 'meta', or -1 if not found
+ */
+int zt_index_lookup_next(const ztstruct_t *meta,
+                         int               last,
+                         const char       *name,
+                         size_t            length);
+
+/**
+ * Build the index for 'meta' now, if it would have one, rather than on
+ * first use.
+ *
+ * \param meta structure to index
+ *
+ * \return zero if out of memory
+ */
+int zt_index_prepare(const ztstruct_t *meta);
+
+/**
+ * Discard all indexes.
+ */
+void zt_index_release(void);
+
+#endif /* ZT_INDEX_H */
+
+/* vim: set ts=8 sts=2 sw=2 et: */
@@ -11,34 +11,53 @@
 
 /* ----------------------------------------------------------------------- */
 
-/* How many ungetc()s to allow. */
-#define MAXUNGOTTEN MAXLEXEME
+/* How many consumed characters a stream buffer retains on refill. This must
+ * cover the longest lexeme. */
+#define ZTLEX_KEEP MAXLEXEME
+
+/* Most integer array elements decoded into a single INTRUN token. */
+#define ZTLEX_MAXRUN (1024)
+
+/* How many token infos the lexer cycles through. A batch of tokens must
+ * remain valid, as must the parser's lookahead from the previous batch. */
+#define ZTLEX_NINFO (ZTLEX_MAXBATCH + 1)
+
+/* Size of the block buffer used when reading from a stream. */
+#define ZTLEX_BUFSZ (32768)
 
 /* ----------------------------------------------------------------------- */
 
 struct ztlex
 {
   FILE           *file;
-  
-  char           *ungottenptr;
-  char            ungotten[MAXUNGOTTEN]; /* ungetc buffer */
+  char           *buffer; /* block buffer for 'file' (ZTLEX_KEEP+ZTLEX_BUFSZ) */
+
+  void           *map; /* memory mapping, if any */
 
-  const char     *string;
+  const char     *string; /* string, mapping, or 'buffer' */
   size_t          length;
   size_t          index; /* an index into 'string' */
 
-  char            lexeme[MAXLEXEME];
+  /* Locations are computed on demand (see ztlex_location) from these and
+   * the characters in 'string'. */
+  size_t          base;      /* input offset of string[0] */
+  int             baseline;  /* line number at 'base' */
+  size_t          linestart; /* input offset of the start of that line */
 
-  int             line;
-  int             column;
-  int             prevcolumn;
+  int             finished;  /* push sources: no more input will be fed */
+  int             starved;   /* push sources: ran out of input mid-token */
+  int             incomment; /* inside a '//' comment */
+  int             failed;    /* met a bad token: no more tokens follow */
 
-  int           (*getC)(struct ztlex *);
-  void          (*ungetC)(int c, struct ztlex *);
+  ztlextok_t      prevtok; /* previous token returned, or zero */
+  unsigned int    run[2][ZTLEX_MAXRUN]; /* decoded INTRUN values */
+  int             currun;  /* index of the most recent run */
 
   ztlex_freefn_t *freefn;
 
-  ztlexinf_t      info; /* exposed to users as const * */
+  ztlexinf_t      info[ZTLEX_NINFO]; /* exposed to users as const *, in turn */
+  int             curinfo; /* index of the most recent info */
+  char            lexeme[ZTLEX_NINFO][MAXLEXEME]; /* lexeme copies for streams */
 };
 
 /* ----------------------------------------------------------------------- */
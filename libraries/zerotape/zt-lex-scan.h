@@ -0,0 +1,177 @@
+/* zt-lex-scan.h -- token scanner, instantiated by zt-lex.c */
+
+/* This is included once for each kind of source so that each gets its own
+ * copy of the scanner with the source handling compiled in. Define
+ * ZTLEX_SCAN_NAME as the function name and ZTLEX_SCAN_STREAM as 1 for a
+ * stream which must be refilled, or 0 for a source held entirely in
+ * memory. */
+
+static int ZTLEX_SCAN_NAME(ztlex_t     *lex,
+                           ztlextok_t  *token,
+                     const ztlexinf_t **info)
+{
+  int          c;
+  int          state;
+  int          len;
+  unsigned int value;
+  ztlextok_t   tok;
+  int          curinfo;
+  ztlexinf_t  *inf;
+
+  /* absorb whitespace and comments */
+  for (;;)
+  {
+    if (lex->incomment)
+    {
+      /* absorb the remainder of the line */
+      while (!ztlex_skipcomment(lex))
+        if (!ZTLEX_SCAN_STREAM || !ztlex_fill(lex))
+          return 0;
+      lex->incomment = 0;
+    }
+
+    if (!ztlex_skipspace(lex))
+    {
+      if (!ZTLEX_SCAN_STREAM || !ztlex_fill(lex))
+        return 0;
+      continue;
+    }
+
+    if (lex->string[lex->index] != '/')
+      break;
+
+    /* a comment needs a second '/' */
+    if (ZTLEX_SCAN_STREAM && lex->index + 1 == lex->length)
+      if (!ztlex_fill(lex) && lex->starved)
+        return 0;
+    if (lex->index + 1 == lex->length || lex->string[lex->index + 1] != '/')
+      break;
+
+    /* we've found '//' */
+    lex->index    += 2;
+    lex->incomment = 1;
+  }
+
+  /* cycle through the info blocks so that earlier tokens' info survives
+   * while the parser holds on to it */
+  curinfo = (lex->curinfo + 1) % ZTLEX_NINFO;
+  inf     = &lex->info[curinfo];
+
+  /* try for a run of integer array elements */
+  if (lex->prevtok == ZTTOKEN_LSQBRA || lex->prevtok == ZTTOKEN_COMMA)
+  {
+    size_t        offset = lex->base + lex->index;
+    unsigned int *run    = lex->run[lex->currun ^ 1];
+    int           n;
+
+    n = ztlex_scanrun(lex, run);
+    if (n > 0)
+    {
+      *token = lex->prevtok = ZTTOKEN_INTRUN;
+
+      inf->offset = offset;
+      inf->lexeme = NULL;
+      inf->length = 0;
+      inf->run    = run;
+      inf->nrun   = n;
+      lex->curinfo = curinfo;
+      lex->currun ^= 1;
+      *info = inf;
+      return 1;
+    }
+  }
+
+  /* run the DFA until it dies, or a stream lexeme outgrows the retained
+   * characters */
+  state = S_START;
+  len   = 0;
+  value = 0;
+  for (;;)
+  {
+    int next;
+
+#if ZTLEX_SCAN_STREAM
+    c = ztlex_peekc(lex);
+    if (c == EOF)
+      break;
+#else
+    if (lex->index == lex->length)
+    {
+      c = EOF;
+      break;
+    }
+    c = (unsigned char) lex->string[lex->index];
+#endif
+
+    next = ztlex_next[state][ztlex_class[c]];
+    if (next == S_DEAD)
+      break;
+
+    lex->index++;
+    state = next;
+    value = value * ztlex_radix[state] + ztlex_digit[c]; /* c < 128 here */
+    if (++len == MAXLEXEME - 1 && ZTLEX_SCAN_STREAM)
+      break;
+  }
+
+#if ZTLEX_SCAN_STREAM
+  if (lex->starved)
+  {
+    /* a push source ran dry: the token may continue in input which hasn't
+     * arrived yet, so back up to its start and try again later */
+    lex->index -= len;
+    return 0;
+  }
+#endif
+
+  tok = ztlex_accept[state];
+  if (tok == 0)
+  {
+    int line, column;
+
+    ztlex_location(lex, lex->base + lex->index - len, &line, &column);
+    if (len == 0 && c != EOF)
+      fprintf(stderr, "Unknown token '%c' at line %d column %d\n", c, line, column);
+    else if (len > 0)
+      fprintf(stderr, "Bad token at line %d column %d\n", line, column);
+    lex->failed = 1;
+    return 0;
+  }
+
+  inf->offset = lex->base + lex->index - len; /* report start of token */
+
+  if (tok < 0)
+  {
+    tok = ztlex_punct((unsigned char) lex->string[lex->index - 1]);
+    inf->lexeme = NULL;
+    inf->length = 0; /* FIXME: Should basic tokens have any length? */
+  }
+  else
+  {
+    const char *lexeme;
+
+    /* the stream buffer retains at least ZTLEX_KEEP consumed characters so
+     * the lexeme is still available, but it will move on the next refill.
+     * memory sources are stable so we can point straight into them. */
+    lexeme = lex->string + lex->index - len;
+    if (ZTLEX_SCAN_STREAM)
+    {
+      memcpy(lex->lexeme[curinfo], lexeme, len);
+      lexeme = lex->lexeme[curinfo];
+    }
+    inf->lexeme = lexeme;
+    inf->length = len;
+    inf->value  = value;
+  }
+
+  lex->curinfo = curinfo;
+
+  *token = lex->prevtok = tok;
+  *info  = inf;
+  return 1;
+}
+
+#undef ZTLEX_SCAN_NAME
+#undef ZTLEX_SCAN_STREAM
+
+/* vim: set ts=8 sts=2 sw=2 et: */
@@ -36,6 +36,7 @@ const char *ztlex_tokname(ztlextok_t t)
   /*     */ case ZTTOKEN_DOLLARHEX: return "DOLLARHEX";
   /*     */ case ZTTOKEN_HEX: return "HEX";
   /*     */ case ZTTOKEN_INT: return "INT";
+  /*     */ case ZTTOKEN_INTRUN: return "INTRUN";
   /*     */ case ZTTOKEN_NAME: return "NAME";
   /*     */ case ZTTOKEN_NIL: return "NIL";
 
@@ -73,7 +74,9 @@ int ztlex_stringtest(const char *string)
     if (rc == 0)
       break;
     if (token == ZTTOKEN_NAME)
-      printf("- %s [%d] (\"%s\")\n", ztlex_tokname(token), token, info->lexeme);
+      printf("- %s [%d] (\"%.*s\")\n", ztlex_tokname(token), token, info->length, info->lexeme);
+    else if (token == ZTTOKEN_INTRUN)
+      printf("- %s [%d] (%d values, last %u)\n", ztlex_tokname(token), token, info->nrun, info->run[info->nrun - 1]);
     else
       printf("- %s [%d]\n", ztlex_tokname(token), token);
   }
@@ -86,76 +89,88 @@ int ztlex_stringtest(const char *string)
 
 /* ----------------------------------------------------------------------- */
 
+/* 320 characters: longer than a stream lexeme may be */
+#define LONGNAME40 "abcdefghijklmnopqrstuvwxyz_0123456789ABC"
+#define LONGNAME   LONGNAME40 LONGNAME40 LONGNAME40 LONGNAME40 \
+                   LONGNAME40 LONGNAME40 LONGNAME40 LONGNAME40
+
 int ztlex_selftest(void)
 {
   static const struct
   {
-    const int  id;
+    const int   id;
     const char *input;
-    int       (*fn)(ztlex_t *);
-    int         count;
+    ztlextok_t  token; /* or zero if no token is expected */
     const char *expectedLexeme;
     size_t      newCursorPos;
+    unsigned    expectedValue; /* for numeric tokens */
   }
   cases[] =
   {
-    {   1, "",      ztlex_isdollarhex, EOF, ""      , 0 },
-    {   2, " ",     ztlex_isdollarhex,   0, ""      , 0 },
-    {   3, "$",     ztlex_isdollarhex,   0, ""      , 0 },
-    {   4, "$$",    ztlex_isdollarhex,   0, ""      , 0 },
-    {   5, "$d",    ztlex_isdollarhex,   2, "$d"    , 2 },
-    {   6, "$d$",   ztlex_isdollarhex,   2, "$d"    , 2 },
-    {   7, "$dae",  ztlex_isdollarhex,   4, "$dae"  , 4 },
-    {   8, "$DAVE", ztlex_isdollarhex,   3, "$DA"   , 3 },
-
-    {  20, "",      ztlex_ishex,       EOF, ""      , 0 },
-    {  21, " ",     ztlex_ishex,         0, ""      , 0 },
-    {  22, "0",     ztlex_ishex,         0, ""      , 0 },
-    {  23, "x",     ztlex_ishex,         0, ""      , 0 },
-    {  24, "0x",    ztlex_ishex,         0, ""      , 0 },
-    {  25, "0xx",   ztlex_ishex,         0, ""      , 0 },
-    {  26, "0x0x",  ztlex_ishex,         3, "0x0"   , 3 },
-    {  27, "0xd",   ztlex_ishex,         3, "0xd"   , 3 },
-    {  28, "0xDg",  ztlex_ishex,         3, "0xD"   , 3 },
-    {  29, "0xDEF", ztlex_ishex,         5, "0xDEF" , 5 },
-
-    {  40, "",      ztlex_isdecimal,   EOF, ""      , 0 },
-    {  41, " ",     ztlex_isdecimal,     0, ""      , 0 },
-    {  42, ".",     ztlex_isdecimal,     0, ""      , 0 },
-    {  43, "..",    ztlex_isdecimal,     0, ""      , 0 },
-    {  44, ".1",    ztlex_isdecimal,     0, ""      , 0 },
-    {  45, "1",     ztlex_isdecimal,     0, ""      , 0 },
-    {  46, "1.2",   ztlex_isdecimal,     0, ""      , 0 },
-    {  47, "1.23",  ztlex_isdecimal,     4, "1.23"  , 4 },
-    {  48, "1.23.", ztlex_isdecimal,     4, "1.23"  , 4 },
-    {  49, "1.234", ztlex_isdecimal,     4, "1.23"  , 4 },
-
-    {  60, "",      ztlex_isinteger,   EOF, ""      , 0 },
-    {  61, " ",     ztlex_isinteger,     0, ""      , 0 },
-    {  62, "-1",    ztlex_isinteger,     0, ""      , 0 },
-    {  63, "0",     ztlex_isinteger,     1, "0"     , 1 },
-    {  64, "0A",    ztlex_isinteger,     1, "0"     , 1 },
-    {  65, "1",     ztlex_isinteger,     1, "1"     , 1 },
-    {  66, "23",    ztlex_isinteger,     2, "23"    , 2 },
-    {  67, "23 ",   ztlex_isinteger,     2, "23"    , 2 },
-    {  68, "45678", ztlex_isinteger,     5, "45678" , 5 },
-
-    {  80, "",      ztlex_isname,      EOF, ""      , 0 },
-    {  81, " ",     ztlex_isname,        0, ""      , 0 },
-    {  82, "0",     ztlex_isname,        0, ""      , 0 },
-    {  83, "A",     ztlex_isname,        1, "A"     , 1 },
-    {  84, "_",     ztlex_isname,        1, "_"     , 1 },
-    {  85, "a0",    ztlex_isname,        2, "a0"    , 2 },
-    {  86, "A0$",   ztlex_isname,        2, "A0"    , 2 },
-    {  87, "a0_",   ztlex_isname,        3, "a0_"   , 3 },
-
-    { 100, "",      ztlex_isnil,       EOF, ""      , 0 },
-    { 101, "n",     ztlex_isnil,       EOF, ""      , 0 },
-    { 102, "ni",    ztlex_isnil,       EOF, ""      , 0 },
-    { 103, " ",     ztlex_isnil,         0, ""      , 0 },
-    { 104, "NIL",   ztlex_isnil,         0, ""      , 0 },
-    { 105, "nil",   ztlex_isnil,         3, "nil"   , 3 },
-    { 106, "nill",  ztlex_isnil,         3, "nil"   , 3 },
+    {   1, "",      0,                 ""      , 0,     0 },
+    {   2, " ",     0,                 ""      , 1,     0 },
+    {   3, "$",     0,                 ""      , 1,     0 },
+    {   4, "$$",    0,                 ""      , 1,     0 },
+    {   5, "$d",    ZTTOKEN_DOLLARHEX, "$d"    , 2,    13 },
+    {   6, "$d$",   ZTTOKEN_DOLLARHEX, "$d"    , 2,    13 },
+    {   7, "$dae",  ZTTOKEN_DOLLARHEX, "$dae"  , 4,  3502 },
+    {   8, "$DAVE", ZTTOKEN_DOLLARHEX, "$DA"   , 3,   218 },
+
+    {  20, "",      0,                 ""      , 0,     0 },
+    {  21, " ",     0,                 ""      , 1,     0 },
+    {  22, "0",     ZTTOKEN_INT,       "0"     , 1,     0 },
+    {  23, "x",     ZTTOKEN_NAME,      "x"     , 1,     0 },
+    {  24, "0x",    0,                 ""      , 2,     0 },
+    {  25, "0xx",   0,                 ""      , 2,     0 },
+    {  26, "0x0x",  ZTTOKEN_HEX,       "0x0"   , 3,     0 },
+    {  27, "0xd",   ZTTOKEN_HEX,       "0xd"   , 3,    13 },
+    {  28, "0xDg",  ZTTOKEN_HEX,       "0xD"   , 3,    13 },
+    {  29, "0xDEF", ZTTOKEN_HEX,       "0xDEF" , 5,  3567 },
+
+    {  40, "",      0,                 ""      , 0,     0 },
+    {  41, " ",     0,                 ""      , 1,     0 },
+    {  42, ".",     0,                 ""      , 0,     0 },
+    {  43, "..",    0,                 ""      , 0,     0 },
+    {  44, ".1",    0,                 ""      , 0,     0 },
+    {  45, "1",     ZTTOKEN_INT,       "1"     , 1,     1 },
+    {  46, "1.2",   0,                 ""      , 3,     0 },
+    {  47, "1.23",  ZTTOKEN_DECIMAL,   "1.23"  , 4,   123 },
+    {  48, "1.23.", ZTTOKEN_DECIMAL,   "1.23"  , 4,   123 },
+    {  49, "1.234", ZTTOKEN_DECIMAL,   "1.23"  , 4,   123 },
+    {  50, "12.34", ZTTOKEN_INT,       "12"    , 2,    12 },
+
+    {  60, "",      0,                 ""      , 0,     0 },
+    {  61, " ",     0,                 ""      , 1,     0 },
+    {  62, "-1",    ZTTOKEN_MINUS,     ""      , 1,     0 },
+    {  63, "0",     ZTTOKEN_INT,       "0"     , 1,     0 },
+    {  64, "0A",    ZTTOKEN_INT,       "0"     , 1,     0 },
+    {  65, "1",     ZTTOKEN_INT,       "1"     , 1,     1 },
+    {  66, "23",    ZTTOKEN_INT,       "23"    , 2,    23 },
+    {  67, "23 ",   ZTTOKEN_INT,       "23"    , 2,    23 },
+    {  68, "45678", ZTTOKEN_INT,       "45678" , 5, 45678 },
+
+    {  80, "",      0,                 ""      , 0,     0 },
+    {  81, " ",     0,                 ""      , 1,     0 },
+    {  82, "0",     ZTTOKEN_INT,       "0"     , 1,     0 },
+    {  83, "A",     ZTTOKEN_NAME,      "A"     , 1,     0 },
+    {  84, "_",     ZTTOKEN_NAME,      "_"     , 1,     0 },
+    {  85, "a0",    ZTTOKEN_NAME,      "a0"    , 2,     0 },
+    {  86, "A0$",   ZTTOKEN_NAME,      "A0"    , 2,     0 },
+    {  87, "a0_",   ZTTOKEN_NAME,      "a0_"   , 3,     0 },
+    {  88, LONGNAME, ZTTOKEN_NAME,     LONGNAME, 320,   0 },
+
+    { 100, "",      0,                 ""      , 0,     0 },
+    { 101, "n",     ZTTOKEN_NAME,      "n"     , 1,     0 },
+    { 102, "ni",    ZTTOKEN_NAME,      "ni"    , 2,     0 },
+    { 103, " ",     0,                 ""      , 1,     0 },
+    { 104, "NIL",   ZTTOKEN_NAME,      "NIL"   , 3,     0 },
+    { 105, "nil",   ZTTOKEN_NIL,       "nil"   , 3,     0 },
+    { 106, "nill",  ZTTOKEN_NIL,       "nil"   , 3,     0 },
+    { 107, "nix",   ZTTOKEN_NAME,      "nix"   , 3,     0 },
+
+    { 120, "// x",  0,                 ""      , 4,     0 },
+    { 121, "//\n=", ZTTOKEN_EQUALS,    ""      , 4,     0 },
+    { 122, "/ /",   ZTTOKEN_DIVIDE,    ""      , 1,     0 },
   };
 
   int totaltests;
@@ -168,26 +183,39 @@ int ztlex_selftest(void)
   totalpassed = 0;
   for (i = 0; i < (int) NELEMS(cases); i++)
   {
-    int      passed;
-    ztlex_t *lex;
-    int      count;
+    int               passed;
+    ztlex_t          *lex;
+    ztlextok_t        token;
+    const ztlexinf_t *info;
 
     printf("--> Test id %d\n", cases[i].id);
 
     passed = 1;
     lex    = ztlex_from_string(malloc, free, cases[i].input);
-    count  = cases[i].fn(lex);
-    if (count != cases[i].count)
+    if (!ztlex_next_token(lex, &token, &info))
+      token = 0;
+    if (token != cases[i].token)
     {
-      printf("diff in test id %d ('%s'): count was %u but we expected %u\n",
-             cases[i].id, cases[i].input, count, cases[i].count);
+      printf("diff in test id %d ('%s'): token was %s but we expected %s\n",
+             cases[i].id, cases[i].input,
+             token ? ztlex_tokname(token) : "none",
+             cases[i].token ? ztlex_tokname(cases[i].token) : "none");
       passed = 0;
     }
-
-    if (cases[i].count > 0 && strcmp(lex->lexeme, cases[i].expectedLexeme) != 0)
+    else if (token && info->length > 0 &&
+             ((size_t) info->length != strlen(cases[i].expectedLexeme) ||
+              memcmp(info->lexeme, cases[i].expectedLexeme, info->length) != 0))
+    {
+      printf("diff in test id %d ('%s'): lexeme was '%.*s' but we expected '%s'\n",
+             cases[i].id, cases[i].input, info->length, info->lexeme, cases[i].expectedLexeme);
+      passed = 0;
+    }
+    else if (token && info->value != cases[i].expectedValue &&
+             (token == ZTTOKEN_INT || token == ZTTOKEN_HEX ||
+              token == ZTTOKEN_DOLLARHEX || token == ZTTOKEN_DECIMAL))
     {
-      printf("diff in test id %d ('%s'): lexeme was '%s' but we expected '%s'\n",
-             cases[i].id, cases[i].input, lex->lexeme, cases[i].expectedLexeme);
+      printf("diff in test id %d ('%s'): value was %u but we expected %u\n",
+             cases[i].id, cases[i].input, info->value, cases[i].expectedValue);
       passed = 0;
     }
 
@@ -224,9 +252,12 @@ int ztlex_dump_filename_to_tokens(const char *filename)
 
   while (ztlex_next_token(lex, &token, &info))
   {
-    printf("%s[%d] [%d,%d] ", ztlex_tokname(token), token, info->line, info->column);
+    int line, column;
+
+    ztlex_location(lex, info->offset, &line, &column);
+    printf("%s[%d] [%d,%d] ", ztlex_tokname(token), token, line, column);
     if (info->length > 0)
-      printf("%s", info->lexeme);
+      printf("%.*s", info->length, info->lexeme);
     printf("\n");
   }
   ztlex_destroy(lex);
@@ -5,6 +5,13 @@
 #include <stdio.h>
 #include <string.h>
 
+#ifdef ZT_USE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "fortify/fortify.h"
 
 #include "zt-gram.h"
@@ -15,135 +22,336 @@
 
 /* ----------------------------------------------------------------------- */
 
-static int ztlex_fgetc(ztlex_t *lex)
+/* Count the newlines in string[0..n), updating 'line' and 'linestart'
+ * (the input offset at which the last line counted starts). */
+static void ztlex_countlines(const ztlex_t *lex,
+                             size_t         n,
+                             int           *line,
+                             size_t        *linestart)
 {
-  int c;
-
-  if (lex->ungottenptr > lex->ungotten)
-    c = *--lex->ungottenptr;
-  else
-    c = fgetc(lex->file);
+  const char *p   = lex->string;
+  const char *end = lex->string + n;
+  const char *q;
 
-  if (c == '\n')
+  while ((q = memchr(p, '\n', (size_t)(end - p))) != NULL)
   {
-    lex->line++;
-    lex->prevcolumn = lex->column;
-    lex->column     = 1;
+    (*line)++;
+    *linestart = lex->base + (size_t)(q - lex->string) + 1;
+    p = q + 1;
   }
-  else
+}
+
+/* Make space in the stream's block buffer. Unconsumed characters are kept,
+ * as are up to ZTLEX_KEEP consumed characters so that the most recent
+ * lexeme is still available. */
+static void ztlex_compact(ztlex_t *lex)
+{
+  size_t from;
+
+  from = (lex->index > ZTLEX_KEEP) ? lex->index - ZTLEX_KEEP : 0;
+
+  /* the discarded characters can't be revisited, so note their lines */
+  ztlex_countlines(lex, from, &lex->baseline, &lex->linestart);
+  lex->base += from;
+
+  memmove(lex->buffer, lex->buffer + from, lex->length - from);
+  lex->length -= from;
+  lex->index  -= from;
+}
+
+/* Refill the stream's block buffer. Returns zero at end of file, or if a
+ * push source has run out of input for now (see 'starved'). */
+static int ztlex_fill(ztlex_t *lex)
+{
+  size_t n;
+
+  if (lex->file == NULL)
   {
-    lex->column++;
+    /* a push source: input arrives through ztlex_feed */
+    if (!lex->finished)
+      lex->starved = 1;
+    return 0;
   }
 
-  return c;
+  ztlex_compact(lex);
+
+  n = fread(lex->buffer + lex->length, 1, ZTLEX_KEEP + ZTLEX_BUFSZ - lex->length, lex->file);
+  lex->length += n;
+
+  return n > 0;
 }
 
-static void ztlex_fungetc(int c, ztlex_t *lex)
+/* ----------------------------------------------------------------------- */
+
+/* Whitespace skipping.
+ *
+ * Saved files are mostly indentation so runs of whitespace are skipped
+ * sixteen bytes at a time where SSE2 is available. */
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ZTLEX_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef ZTLEX_SSE2
+
+/* Index of the lowest set bit. 'x' must be non-zero. */
+static int ztlex_lowestbit(unsigned int x)
 {
-  if (c == '\n')
+#ifdef __GNUC__
+  return __builtin_ctz(x);
+#else
+  int i;
+
+  for (i = 0; (x & 1) == 0; i++)
+    x >>= 1;
+  return i;
+#endif
+}
+
+#endif /* ZTLEX_SSE2 */
+
+/* Skip whitespace in the current buffer. Returns non-zero if a
+ * non-whitespace character was reached, or zero if the buffer ran out. */
+static int ztlex_skipspace(ztlex_t *lex)
+{
+  const unsigned char *base = (const unsigned char *) lex->string;
+  size_t               i    = lex->index;
+  size_t               n    = lex->length;
+
+#ifdef ZTLEX_SSE2
   {
-    assert(lex->line >= 0);
-    lex->line--;
-    assert(lex->prevcolumn >= 0);
-    lex->column     = lex->prevcolumn;
-    lex->prevcolumn = -1; /* invalidate */
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab   = _mm_set1_epi8('\t');
+    const __m128i four  = _mm_set1_epi8(4);
+
+    while (i + 16 <= n)
+    {
+      __m128i      v;
+      __m128i      t;
+      unsigned int ws;
+      int          run;
+
+      v = _mm_loadu_si128((const __m128i *) (base + i));
+      /* ' ' or '\t'..'\r' */
+      t  = _mm_sub_epi8(v, tab);
+      t  = _mm_cmpeq_epi8(_mm_min_epu8(t, four), t);
+      t  = _mm_or_si128(t, _mm_cmpeq_epi8(v, space));
+      ws = (unsigned int) _mm_movemask_epi8(t);
+
+      run = (ws == 0xFFFF) ? 16 : ztlex_lowestbit(~ws);
+
+      i += run;
+      if (run < 16)
+      {
+        lex->index = i;
+        return 1;
+      }
+    }
   }
-  else
+#endif
+
+  for (; i < n; i++)
   {
-    lex->column--;
+    if (!isspace(base[i]))
+    {
+      lex->index = i;
+      return 1;
+    }
   }
 
-  if (lex->ungottenptr - lex->ungotten < MAXUNGOTTEN)
-    *lex->ungottenptr++ = c;
+  lex->index = i;
+  return 0;
 }
 
+/* Skip the body of a '//' comment up to, but not including, its newline.
+ * Returns non-zero if the newline was reached. */
+static int ztlex_skipcomment(ztlex_t *lex)
+{
+  const char *p;
+  const char *q;
+
+  p = lex->string + lex->index;
+  q = memchr(p, '\n', lex->length - lex->index);
+  if (q == NULL)
+    q = lex->string + lex->length;
+
+  lex->index += (size_t)(q - p);
+
+  return lex->index < lex->length;
+}
+
+/* ----------------------------------------------------------------------- */
+
 ztlex_t *ztlex_from_file(ztlex_mallocfn_t *mallocfn,
                          ztlex_freefn_t   *freefn,
                          const char       *filename)
 {
   ztlex_t *lex = NULL;
 
+  /* Regular files are mapped and lexed in place where possible. Anything
+   * else (pipes, or platforms without mmap) gets read in blocks. */
+  lex = ztlex_from_mmap(mallocfn, freefn, filename);
+  if (lex)
+    return lex;
+
   lex = mallocfn(sizeof(*lex));
   if (lex == NULL)
     return NULL;
 
-  lex->file = fopen(filename, "r");
+  lex->buffer = mallocfn(ZTLEX_KEEP + ZTLEX_BUFSZ);
+  if (lex->buffer == NULL)
+  {
+    freefn(lex);
+    return NULL;
+  }
+
+  lex->file = fopen(filename, "rb");
   if (lex->file == NULL)
   {
+    freefn(lex->buffer);
     freefn(lex);
     return NULL;
   }
 
-  lex->ungottenptr = &lex->ungotten[0];
+  lex->map         = NULL;
 
-  lex->string      = NULL;
+  lex->string      = lex->buffer;
   lex->length      = 0;
   lex->index       = 0;
 
-  lex->line        = 1;
-  lex->column      = 1;
-  lex->prevcolumn  = -1;
+  lex->base        = 0;
+  lex->baseline    = 1;
+  lex->linestart   = 0;
+
+  lex->finished    = 0;
+  lex->starved     = 0;
+  lex->incomment   = 0;
+  lex->failed      = 0;
 
-  lex->getC        = ztlex_fgetc;
-  lex->ungetC      = ztlex_fungetc;
+  lex->prevtok     = 0;
+  lex->currun      = 0;
+  lex->curinfo     = 0;
 
   lex->freefn      = freefn;
 
   return lex;
 }
 
-static int ztlex_sgetc(ztlex_t *lex)
+ztlex_t *ztlex_from_string(ztlex_mallocfn_t *mallocfn,
+                           ztlex_freefn_t   *freefn,
+                           const char       *string)
 {
-  int c;
+  return ztlex_from_buffer(mallocfn, freefn, string, strlen(string));
+}
 
-  assert(lex->string);
-  assert(lex->index <= lex->length);
+ztlex_t *ztlex_from_buffer(ztlex_mallocfn_t *mallocfn,
+                           ztlex_freefn_t   *freefn,
+                           const char       *data,
+                           size_t            length)
+{
+  ztlex_t *lex = NULL;
 
-  if (lex->index == lex->length)
-    return EOF;
+  lex = mallocfn(sizeof(*lex));
+  if (lex == NULL)
+    return NULL;
 
-  c = lex->string[lex->index++];
-  if (c == '\n')
-  {
-    lex->line++;
-    lex->prevcolumn = lex->column;
-    lex->column = 1;
-  }
-  else
-  {
-    lex->column++;
-  }
+  lex->file        = NULL;
+  lex->buffer      = NULL;
+
+  lex->map         = NULL;
+
+  lex->string      = data; /* lexed in place, not copied */
+  lex->length      = length;
+  lex->index       = 0;
+
+  lex->base        = 0;
+  lex->baseline    = 1;
+  lex->linestart   = 0;
 
-  return c;
+  lex->finished    = 0;
+  lex->starved     = 0;
+  lex->incomment   = 0;
+  lex->failed      = 0;
+
+  lex->prevtok     = 0;
+  lex->currun      = 0;
+  lex->curinfo     = 0;
+
+  lex->freefn      = freefn;
+
+  return lex;
 }
 
-static void ztlex_sungetc(int c, ztlex_t *lex)
+ztlex_t *ztlex_from_mmap(ztlex_mallocfn_t *mallocfn,
+                         ztlex_freefn_t   *freefn,
+                         const char       *filename)
 {
-  assert(lex->string);
-  assert(lex->index >= 1);
-  assert(lex->index <= lex->length);
+#ifdef ZT_USE_MMAP
+  ztlex_t    *lex = NULL;
+  int         fd;
+  struct stat st;
+  void       *map;
+
+  fd = open(filename, O_RDONLY);
+  if (fd < 0)
+    return NULL;
 
-  if (c == '\n')
+  /* Only regular, non-empty files can be mapped */
+  if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
   {
-    assert(lex->line >= 0);
-    lex->line--;
-    assert(lex->prevcolumn >= 0);
-    lex->column = lex->prevcolumn;
-    lex->prevcolumn = -1; /* invalidate */
+    close(fd);
+    return NULL;
   }
-  else
+
+  map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd); /* the mapping persists */
+  if (map == MAP_FAILED)
+    return NULL;
+
+#ifdef MADV_SEQUENTIAL
+  (void) madvise(map, (size_t) st.st_size, MADV_SEQUENTIAL);
+#endif
+
+  lex = mallocfn(sizeof(*lex));
+  if (lex == NULL)
   {
-    lex->column--;
+    munmap(map, (size_t) st.st_size);
+    return NULL;
   }
 
-  lex->index--;
+  lex->file        = NULL;
+  lex->buffer      = NULL;
+
+  lex->map         = map;
+
+  lex->string      = map;
+  lex->length      = (size_t) st.st_size;
+  lex->index       = 0;
+
+  lex->base        = 0;
+  lex->baseline    = 1;
+  lex->linestart   = 0;
+
+  lex->finished    = 0;
+  lex->starved     = 0;
+  lex->incomment   = 0;
+  lex->failed      = 0;
+
+  lex->prevtok     = 0;
+  lex->currun      = 0;
+  lex->curinfo     = 0;
+
+  lex->freefn      = freefn;
 
-  assert(lex->string[lex->index] == c);
+  return lex;
+#else
+  return NULL;
+#endif
 }
 
-ztlex_t *ztlex_from_string(ztlex_mallocfn_t *mallocfn,
-                           ztlex_freefn_t   *freefn,
-                           const char       *string)
+ztlex_t *ztlex_for_push(ztlex_mallocfn_t *mallocfn,
+                        ztlex_freefn_t   *freefn)
 {
   ztlex_t *lex = NULL;
 
@@ -151,421 +359,535 @@ ztlex_t *ztlex_from_string(ztlex_mallocfn_t *mallocfn,
   if (lex == NULL)
     return NULL;
 
+  lex->buffer = mallocfn(ZTLEX_KEEP + ZTLEX_BUFSZ);
+  if (lex->buffer == NULL)
+  {
+    freefn(lex);
+    return NULL;
+  }
+
   lex->file        = NULL;
-  lex->ungottenptr = NULL;
 
-  lex->string      = string; /* FIXME: Copy string */
-  lex->length      = strlen(string);
+  lex->map         = NULL;
+
+  lex->string      = lex->buffer;
+  lex->length      = 0;
   lex->index       = 0;
 
-  lex->line        = 1;
-  lex->column      = 1;
-  lex->prevcolumn  = -1;
+  lex->base        = 0;
+  lex->baseline    = 1;
+  lex->linestart   = 0;
+
+  lex->finished    = 0;
+  lex->starved     = 0;
+  lex->incomment   = 0;
+  lex->failed      = 0;
 
-  lex->getC        = ztlex_sgetc;
-  lex->ungetC      = ztlex_sungetc;
+  lex->prevtok     = 0;
+  lex->currun      = 0;
+  lex->curinfo     = 0;
 
   lex->freefn      = freefn;
 
   return lex;
 }
 
-void ztlex_destroy(ztlex_t *lex)
+int ztlex_open(ztlex_t *lex, const char *filename)
 {
-  if (lex == NULL)
-    return;
+  FILE *file;
 
-  if (lex->file)
-  {
-    if (!feof(lex->file))
-      fprintf(stderr, "warning: lexer closed with bytes pending\n");
+  assert(lex->buffer);
+  assert(lex->map == NULL);
 
-    fclose(lex->file);
-  }
-  else
-  {
-    int remaining = (int)(lex->length - lex->index);
-    if (remaining)
-      fprintf(stderr, "warning: lexer closed with %d bytes pending\n",
-              remaining);
-  }
+  file = fopen(filename, "rb");
+  if (file == NULL)
+    return 0;
 
-  lex->freefn(lex);
-}
+  ztlex_close(lex);
 
-/* The is*() functions return the length of token, 0 if not valid, or EOF. */
+  lex->file        = file;
 
-/* '$'[:hexdigit:]+ */
-int ztlex_isdollarhex(ztlex_t *lex)
-{
-  int i = 0;
-  int c;
+  lex->string      = lex->buffer;
+  lex->length      = 0;
+  lex->index       = 0;
 
-  c = lex->getC(lex);
-  if (c == EOF)
-    return EOF;
+  lex->base        = 0;
+  lex->baseline    = 1;
+  lex->linestart   = 0;
 
-  if (c != '$')
-  {
-    lex->ungetC(c, lex);
-    return 0;
-  }
+  lex->finished    = 0;
+  lex->starved     = 0;
+  lex->incomment   = 0;
+  lex->failed      = 0;
 
-  do
-  {
-    lex->lexeme[i++] = c;
-    c = lex->getC(lex);
-  }
-  while (isxdigit(c) && i < MAXLEXEME - 1);
+  lex->prevtok     = 0;
+  lex->currun      = 0;
+  lex->curinfo     = 0;
 
-  if (c != EOF && !isxdigit(c))
-    lex->ungetC(c, lex);
+  return 1;
+}
 
-  if (i < 2)
-  {
-    while (--i >= 0)
-      lex->ungetC(lex->lexeme[i], lex);
-    return 0;
-  }
+void ztlex_close(ztlex_t *lex)
+{
+  if (lex->file == NULL)
+    return;
 
-  lex->lexeme[i] = '\0';
-  return i;
+  fclose(lex->file);
+  lex->file = NULL;
+
+  /* nothing is pending once the file is gone */
+  lex->length   = 0;
+  lex->index    = 0;
+  lex->finished = 1;
 }
 
-/* '0x'[:hexdigit:]+ */
-int ztlex_ishex(ztlex_t *lex)
+size_t ztlex_feed(ztlex_t    *lex,
+                  const void *bytes,
+                  size_t      n)
 {
-  int i = 0;
-  int c;
+  size_t space;
 
-  c = lex->getC(lex);
-  if (c == EOF)
-    return EOF;
+  assert(lex);
+  assert(lex->buffer && lex->file == NULL);
+  assert(!lex->finished);
 
-  if (c != '0')
-  {
-    lex->ungetC(c, lex);
-    return 0;
-  }
+  ztlex_compact(lex);
 
-  lex->lexeme[i++] = c;
+  space = ZTLEX_KEEP + ZTLEX_BUFSZ - lex->length;
+  if (n > space)
+    n = space;
 
-  c = lex->getC(lex);
-  if (c != 'x') /* including EOF */
-  {
-    if (c != EOF)
-      lex->ungetC(c, lex);
-    goto undo;
-  }
+  memcpy(lex->buffer + lex->length, bytes, n);
+  lex->length += n;
 
-  do
-  {
-    lex->lexeme[i++] = c;
-    c = lex->getC(lex);
-  }
-  while (isxdigit(c) && i < MAXLEXEME - 1);
+  return n;
+}
 
-  if (c != EOF && !isxdigit(c))
-    lex->ungetC(c, lex);
+void ztlex_finish(ztlex_t *lex)
+{
+  assert(lex);
 
-  if (i < 3)
-  {
-undo:
-    while (--i >= 0)
-      lex->ungetC(lex->lexeme[i], lex);
-    return 0;
-  }
+  lex->finished = 1;
+}
 
-  lex->lexeme[i] = '\0';
-  return i;
+int ztlex_starved(const ztlex_t *lex)
+{
+  assert(lex);
+
+  return lex->starved;
 }
 
-/* [:digit:]'.'[:digit:][:digit:] */
-int ztlex_isdecimal(ztlex_t *lex)
+void ztlex_destroy(ztlex_t *lex)
 {
-  int i = 0;
-  int c;
+  if (lex == NULL)
+    return;
 
-  c = lex->getC(lex);
-  if (c == EOF)
-    return EOF;
+  if (lex->file)
+  {
+    if (lex->index < lex->length || !feof(lex->file))
+      fprintf(stderr, "warning: lexer closed with bytes pending\n");
 
-  if (!isdigit(c))
+    fclose(lex->file);
+    lex->freefn(lex->buffer);
+  }
+  else
   {
-    lex->ungetC(c, lex);
-    return 0;
+    int remaining = (int)(lex->length - lex->index);
+    if (remaining)
+      fprintf(stderr, "warning: lexer closed with %d bytes pending\n",
+              remaining);
+
+    if (lex->buffer)
+      lex->freefn(lex->buffer); /* a push source */
   }
 
-  lex->lexeme[i++] = c;
+#ifdef ZT_USE_MMAP
+  if (lex->map)
+    munmap(lex->map, lex->length);
+#endif
 
-  c = lex->getC(lex);
-  if (c != '.') /* including EOF */
-  {
-    if (c != EOF)
-      lex->ungetC(c, lex);
-    goto undo;
-  }
+  lex->freefn(lex);
+}
 
-  lex->lexeme[i++] = c;
+/* The lexer is a DFA driven by two precomputed tables: one which reduces
+ * input bytes to character classes and one which gives the next state for
+ * each (state, class) pair. Tokens are recognised in a single forward pass
+ * with one character of lookahead.
+ *
+ * Where the DFA dies in a non-accepting state (e.g. on "0x" or "1.") the
+ * input can't form a valid program so no backtracking is attempted. */
 
-  c = lex->getC(lex);
-  if (!isdigit(c)) /* including EOF */
+/* Character classes. */
+enum
+{
+  C_OTHER,  /* anything unrecognised, including whitespace */
+  C_ZERO,   /* 0 */
+  C_DIGIT,  /* 1-9 */
+  C_HEX,    /* a-f A-F */
+  C_X,      /* x */
+  C_N,      /* n */
+  C_I,      /* i */
+  C_L,      /* l */
+  C_ALPHA,  /* remaining letters and _ */
+  C_DOLLAR, /* $ */
+  C_DOT,    /* . */
+  C_PUNCT,  /* single character tokens */
+  C__LIMIT
+};
+
+/* States. */
+enum
+{
+  S_DEAD,   /* no transition */
+  S_START,
+  S_ZERO,   /* 0                        INT */
+  S_DIGIT,  /* [1-9]                    INT */
+  S_INT,    /* [:digit:][:digit:]+      INT */
+  S_0X,     /* 0x */
+  S_HEX,    /* 0x[:xdigit:]+            HEX */
+  S_DOLLAR, /* $ */
+  S_DHEX,   /* $[:xdigit:]+             DOLLARHEX */
+  S_DOT,    /* [:digit:]. */
+  S_DOTD,   /* [:digit:].[:digit:] */
+  S_DEC,    /* [:digit:].[:digit:]{2}   DECIMAL */
+  S_N,      /* n                        NAME */
+  S_NI,     /* ni                       NAME */
+  S_NIL,    /* nil                      NIL */
+  S_NAME,   /* [:alpha:_][:alnum:_]*    NAME */
+  S_PUNCT,  /* single character token */
+  S__LIMIT
+};
+
+#define O C_OTHER
+#define Z C_ZERO
+#define D C_DIGIT
+#define H C_HEX
+#define X C_X
+#define N C_N
+#define I C_I
+#define L C_L
+#define A C_ALPHA
+#define S C_DOLLAR
+#define P C_DOT
+#define U C_PUNCT
+
+/* Top bit set characters are omitted: they default to C_OTHER. */
+static const unsigned char ztlex_class[256] =
+{
+  O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, /* 00-0F */
+  O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, /* 10-1F */
+  O, O, O, O, S, O, O, O, U, U, U, U, U, U, P, U, /* 20-2F */
+  Z, D, D, D, D, D, D, D, D, D, O, U, O, U, O, O, /* 30-3F */
+  O, H, H, H, H, H, H, A, A, A, A, A, A, A, A, A, /* 40-4F */
+  A, A, A, A, A, A, A, A, A, A, A, U, O, U, O, A, /* 50-5F */
+  O, H, H, H, H, H, H, A, A, I, A, A, L, A, N, A, /* 60-6F */
+  A, A, A, A, A, A, A, A, X, A, A, U, O, U, O, O, /* 70-7F */
+};
+
+#undef O
+#undef Z
+#undef D
+#undef H
+#undef X
+#undef N
+#undef I
+#undef L
+#undef A
+#undef S
+#undef P
+#undef U
+
+static const unsigned char ztlex_next[S__LIMIT][C__LIMIT] =
+{
+  /*            OTHER   ZERO     DIGIT    HEX      X       N       I       L       ALPHA   DOLLAR    DOT     PUNCT   */
+  /* DEAD   */{ S_DEAD, S_DEAD,  S_DEAD,  S_DEAD,  S_DEAD, S_DEAD, S_DEAD, S_DEAD, S_DEAD, S_DEAD,   S_DEAD, S_DEAD  },
+  /* START  */{ S_DEAD, S_ZERO,  S_DIGIT, S_NAME,  S_NAME, S_N,    S_NAME, S_NAME, S_NAME, S_DOLLAR, S_DEAD, S_PUNCT },
+  /* ZERO   */{ S_DEAD, S_INT,   S_INT,   S_DEAD,  S_0X,   S_DEAD, S_DEAD, S_DEAD, S_DEAD, S_DEAD,   S_DOT,  S_DEAD  },
+  /* DIGIT  */{ S_DEAD, S_INT,   S_INT,   S_DEAD,  S_DEAD, S_DEAD, S_DEAD, S_DEAD, S_DEAD, S_DEAD,   S_DOT,  S_DEAD  },
+  /* INT    */{ S_DEAD, S_INT,   S_INT,   S_DEAD,  S_DEAD, S_DEAD, S_DEAD, S_DEAD, S_DEAD, S_DEAD,   S_DEAD, S_DEAD  },
+  /* 0X     */{ S_DEAD, S_HEX,   S_HEX,   S_HEX,   S_DEAD, S_DEAD, S_DEAD, S_DEAD, S_DEAD, S_DEAD,   S_DEAD, S_DEAD  },
+  /* HEX    */{ S_DEAD, S_HEX,   S_HEX,   S_HEX,   S_DEAD, S_DEAD, S_DEAD, S_DEAD, S_DEAD, S_DEAD,   S_DEAD, S_DEAD  },
+  /* DOLLAR */{ S_DEAD, S_DHEX,  S_DHEX,  S_DHEX,  S_DEAD, S_DEAD, S_DEAD, S_DEAD, S_DEAD, S_DEAD,   S_DEAD, S_DEAD  },
+  /* DHEX   */{ S_DEAD, S_DHEX,  S_DHEX,  S_DHEX,  S_DEAD, S_DEAD, S_DEAD, S_DEAD, S_DEAD, S_DEAD,   S_DEAD, S_DEAD  },
+  /* DOT    */{ S_DEAD, S_DOTD,  S_DOTD,  S_DEAD,  S_DEAD, S_DEAD, S_DEAD, S_DEAD, S_DEAD, S_DEAD,   S_DEAD, S_DEAD  },
+  /* DOTD   */{ S_DEAD, S_DEC,   S_DEC,   S_DEAD,  S_DEAD, S_DEAD, S_DEAD, S_DEAD, S_DEAD, S_DEAD,   S_DEAD, S_DEAD  },
+  /* DEC    */{ S_DEAD, S_DEAD,  S_DEAD,  S_DEAD,  S_DEAD, S_DEAD, S_DEAD, S_DEAD, S_DEAD, S_DEAD,   S_DEAD, S_DEAD  },
+  /* N      */{ S_DEAD, S_NAME,  S_NAME,  S_NAME,  S_NAME, S_NAME, S_NI,   S_NAME, S_NAME, S_DEAD,   S_DEAD, S_DEAD  },
+  /* NI     */{ S_DEAD, S_NAME,  S_NAME,  S_NAME,  S_NAME, S_NAME, S_NAME, S_NIL,  S_NAME, S_DEAD,   S_DEAD, S_DEAD  },
+  /* NIL    */{ S_DEAD, S_DEAD,  S_DEAD,  S_DEAD,  S_DEAD, S_DEAD, S_DEAD, S_DEAD, S_DEAD, S_DEAD,   S_DEAD, S_DEAD  },
+  /* NAME   */{ S_DEAD, S_NAME,  S_NAME,  S_NAME,  S_NAME, S_NAME, S_NAME, S_NAME, S_NAME, S_DEAD,   S_DEAD, S_DEAD  },
+  /* PUNCT  */{ S_DEAD, S_DEAD,  S_DEAD,  S_DEAD,  S_DEAD, S_DEAD, S_DEAD, S_DEAD, S_DEAD, S_DEAD,   S_DEAD, S_DEAD  },
+};
+
+/* Token accepted in each state, or zero if the state is not accepting.
+ * S_PUNCT is resolved by ztlex_punct(). */
+static const ztlextok_t ztlex_accept[S__LIMIT] =
+{
+  0,                 /* DEAD   */
+  0,                 /* START  */
+  ZTTOKEN_INT,       /* ZERO   */
+  ZTTOKEN_INT,       /* DIGIT  */
+  ZTTOKEN_INT,       /* INT    */
+  0,                 /* 0X     */
+  ZTTOKEN_HEX,       /* HEX    */
+  0,                 /* DOLLAR */
+  ZTTOKEN_DOLLARHEX, /* DHEX   */
+  0,                 /* DOT    */
+  0,                 /* DOTD   */
+  ZTTOKEN_DECIMAL,   /* DEC    */
+  ZTTOKEN_NAME,      /* N      */
+  ZTTOKEN_NAME,      /* NI     */
+  ZTTOKEN_NIL,       /* NIL    */
+  ZTTOKEN_NAME,      /* NAME   */
+  -1                 /* PUNCT  */
+};
+
+/* Numeric values are accumulated as the DFA runs: on entering a state the
+ * value so far is multiplied by the state's radix and the digit value of the
+ * character is added. Prefixes ('$', '0x') have a radix of zero so reset the
+ * value and decimals accumulate as fixed point, i.e. "1.23" gives 123. */
+static const unsigned char ztlex_radix[S__LIMIT] =
+{
+  0,  /* DEAD   */
+  0,  /* START  */
+  10, /* ZERO   */
+  10, /* DIGIT  */
+  10, /* INT    */
+  0,  /* 0X     */
+  16, /* HEX    */
+  0,  /* DOLLAR */
+  16, /* DHEX   */
+  1,  /* DOT    */
+  10, /* DOTD   */
+  10, /* DEC    */
+  0,  /* N      */
+  0,  /* NI     */
+  0,  /* NIL    */
+  0,  /* NAME   */
+  0   /* PUNCT  */
+};
+
+/* Value of each hex digit character. Everything else is zero. */
+static const unsigned char ztlex_digit[128] =
+{
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 00-0F */
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 10-1F */
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 20-2F */
+  0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 0, 0, 0, 0, 0, 0, /* 30-3F */
+  0,10,11,12,13,14,15, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 40-4F */
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 50-5F */
+  0,10,11,12,13,14,15, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 60-6F */
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 70-7F */
+};
+
+static ztlextok_t ztlex_punct(int c)
+{
+  switch (c)
   {
-    if (c != EOF)
-      lex->ungetC(c, lex);
-    goto undo;
+    case '(': return ZTTOKEN_LPAREN;
+    case ')': return ZTTOKEN_RPAREN;
+    case '*': return ZTTOKEN_TIMES;
+    case '+': return ZTTOKEN_PLUS;
+    case ',': return ZTTOKEN_COMMA;
+    case '-': return ZTTOKEN_MINUS;
+    case '/': return ZTTOKEN_DIVIDE;
+    case ';': return ZTTOKEN_SEMICOLON;
+    case '=': return ZTTOKEN_EQUALS;
+    case '[': return ZTTOKEN_LSQBRA;
+    case ']': return ZTTOKEN_RSQBRA;
+    case '{': return ZTTOKEN_LBRACE;
+    case '}': return ZTTOKEN_RBRACE;
+    default:  assert(0); return 0;
   }
+}
 
-  lex->lexeme[i++] = c;
+/* Integer array runs.
+ *
+ * Integer arrays are the bulk of most saved files. Rather than pass each
+ * element through the lexer and parser separately a run of plain literals
+ * following '[' or ',' is decoded here in one go and handed to the parser as
+ * a single INTRUN token.
+ *
+ * A literal joins the run only if it's followed by ',' or ']', so anything
+ * which is part of an expression is left for the DFA. The run stops short
+ * of the separator after its final literal. */
+
+/* Decode one literal at 'p'. Returns a pointer past it, or NULL. */
+static const unsigned char *ztlex_runliteral(const unsigned char *p,
+                                             const unsigned char *end,
+                                             unsigned int        *pvalue)
+{
+  const unsigned char *start;
+  unsigned int         value = 0;
 
-  c = lex->getC(lex);
-  if (!isdigit(c)) /* including EOF */
+  if (*p == '$' || (*p == '0' && p + 1 < end && p[1] == 'x'))
   {
-    if (c != EOF)
-      lex->ungetC(c, lex);
-    goto undo;
+    p += (*p == '$') ? 1 : 2;
+    for (start = p; p < end && (ztlex_class[*p] == C_ZERO ||
+                                ztlex_class[*p] == C_DIGIT ||
+                                ztlex_class[*p] == C_HEX); p++)
+      value = value * 16 + ztlex_digit[*p];
+  }
+  else
+  {
+    for (start = p; p < end && (unsigned) (*p - '0') <= 9; p++)
+      value = value * 10 + (*p - '0');
   }
 
-  lex->lexeme[i++] = c;
-
-  lex->lexeme[i] = '\0';
-  return i;
+  if (p == start)
+    return NULL;
 
-undo:
-  while (--i >= 0)
-    lex->ungetC(lex->lexeme[i], lex);
-  return 0;
+  *pvalue = value;
+  return p;
 }
 
-/* [:digit:]+ */
-int ztlex_isinteger(ztlex_t *lex)
+/* Returns the number of values decoded into 'run'. */
+static int ztlex_scanrun(ztlex_t *lex, unsigned int *run)
 {
-  int i = 0;
-  int c;
-
-  c = lex->getC(lex);
-  if (c == EOF)
-    return EOF;
+  const unsigned char *base = (const unsigned char *) lex->string;
+  const unsigned char *end  = base + lex->length;
+  const unsigned char *p;
+  const unsigned char *committed;
+  int                  n;
 
-  if (!isdigit(c))
+  p         = base + lex->index;
+  committed = p;
+  n         = 0;
+  while (n < ZTLEX_MAXRUN)
   {
-    lex->ungetC(c, lex);
-    return 0;
-  }
+    const unsigned char *q;
+    const unsigned char *r;
+    unsigned int         value;
 
-  do
-  {
-    lex->lexeme[i++] = c;
-    c = lex->getC(lex);
+    q = ztlex_runliteral(p, end, &value);
+    if (q == NULL)
+      break;
+
+    /* find what follows the literal */
+    for (r = q; r < end && isspace(*r); r++)
+      ;
+    if (r == end || (*r != ',' && *r != ']'))
+      break;
+
+    run[n++] = value;
+    committed = q;
+
+    if (*r == ']')
+      break;
+
+    /* step over the comma and any whitespace after it */
+    for (r++; r < end && isspace(*r); r++)
+      ;
+    if (r == end)
+      break;
+
+    p = r;
   }
-  while (isdigit(c) && i < MAXLEXEME - 1);
 
-  if (c != EOF && !isdigit(c))
-    lex->ungetC(c, lex);
+  lex->index = (size_t)(committed - base);
 
-  lex->lexeme[i] = '\0';
-  return i;
+  return n;
 }
 
-/* "nil" */
-int ztlex_isnil(ztlex_t *lex)
-{
-  int i = 0;
-  int c;
+/* ----------------------------------------------------------------------- */
 
-  c = lex->getC(lex);
-  if (c == EOF)
+/* Returns the next character without consuming it, or EOF. Streams only. */
+static int ztlex_peekc(ztlex_t *lex)
+{
+  if (lex->index == lex->length && !ztlex_fill(lex))
     return EOF;
-  if (c != 'n')
-  {
-    lex->ungetC(c, lex);
-    return 0;
-  }
-  lex->lexeme[i++] = c;
 
-  c = lex->getC(lex);
-  if (c != 'i')
-  {
-    if (c != EOF)
-      lex->ungetC(c, lex);
-    goto undo;
-  }
-  lex->lexeme[i++] = c;
+  return (unsigned char) lex->string[lex->index];
+}
 
-  c = lex->getC(lex);
-  if (c != 'l')
-  {
-    if (c != EOF)
-      lex->ungetC(c, lex);
-    goto undo;
-  }
-  lex->lexeme[i++] = c;
+/* Scanners for memory (string or mapping) and stream sources. */
 
-  lex->lexeme[i] = '\0';
-  return 3;
+#define ZTLEX_SCAN_NAME   ztlex_next_token_memory
+#define ZTLEX_SCAN_STREAM 0
+#include "zt-lex-scan.h"
 
-undo:
-  while (--i >= 0)
-    lex->ungetC(lex->lexeme[i], lex);
-  return (c == EOF) ? c : 0;
-}
+#define ZTLEX_SCAN_NAME   ztlex_next_token_stream
+#define ZTLEX_SCAN_STREAM 1
+#include "zt-lex-scan.h"
 
-/* [:alpha:_][:alnum:_]* */
-int ztlex_isname(ztlex_t *lex)
+void ztlex_location(const ztlex_t *lex,
+                    size_t         offset,
+                    int           *line,
+                    int           *column)
 {
-  int i = 0;
-  int c;
+  int    l;
+  size_t linestart;
 
-  c = lex->getC(lex);
-  if (c == EOF)
-    return EOF;
+  assert(lex);
+  assert(line);
+  assert(column);
 
-  if (!(isalpha(c) || c == '_'))
+  if (offset < lex->base)
   {
-    lex->ungetC(c, lex);
-    return 0;
+    /* discarded from the stream buffer */
+    *line   = 0;
+    *column = 0;
+    return;
   }
 
-  do
-  {
-    lex->lexeme[i++] = c;
-    c = lex->getC(lex);
-  }
-  while ((isalnum(c) || c == '_') && i < MAXLEXEME - 1);
+  if (offset > lex->base + lex->length)
+    offset = lex->base + lex->length;
 
-  if (c != EOF && !(isalnum(c) || c == '_'))
-    lex->ungetC(c, lex);
+  l         = lex->baseline;
+  linestart = lex->linestart;
+  ztlex_countlines(lex, offset - lex->base, &l, &linestart);
 
-  lex->lexeme[i] = '\0';
-  return i;
+  *line   = l;
+  *column = (int)(offset - linestart) + 1;
 }
 
 int ztlex_next_token(ztlex_t     *lex,
                      ztlextok_t  *token,
                const ztlexinf_t **info)
 {
-  static const struct
-  {
-    int        (*fn)(ztlex_t *);
-    ztlextok_t token;
-  }
-  map[] =
-  {
-    { ztlex_isdollarhex, ZTTOKEN_DOLLARHEX },
-    { ztlex_ishex,       ZTTOKEN_HEX       },
-    { ztlex_isdecimal,   ZTTOKEN_DECIMAL   },
-    { ztlex_isinteger,   ZTTOKEN_INT       },
-    { ztlex_isnil,       ZTTOKEN_NIL       },
-    { ztlex_isname,      ZTTOKEN_NAME      },
-  };
-
-  int c;
-  int i;
-
   assert(lex);
   assert(token);
   assert(info);
 
   *info = NULL;
 
-again:
-  /* absorb all leading whitespace */
-  do
-  {
-    c = lex->getC(lex);
-    if (c == EOF)
-      return 0;
-  }
-  while (isspace(c));
-
-  lex->ungetC(c, lex);
-
-  /* absorb comments */
-  {
-    c = lex->getC(lex);
-    if (c == EOF)
-      return 0;
+  if (lex->failed)
+    return 0;
 
-    if (c != '/')
-    {
-      lex->ungetC(c, lex);
-      goto notcomment;
-    }
+  lex->starved = 0;
 
-    c = lex->getC(lex);
-    if (c != '/') /* including EOF */
-    {
-      if (c != EOF)
-        lex->ungetC(c, lex);
-      lex->ungetC('/', lex);
-      goto notcomment;
-    }
-
-    /* we've found '//' - absorb the remainder of the line */
-    do
-      c = lex->getC(lex);
-    while (c != '\n');
+  if (lex->buffer)
+    return ztlex_next_token_stream(lex, token, info);
+  else
+    return ztlex_next_token_memory(lex, token, info);
+}
 
-    if (c != EOF)
-      lex->ungetC(c, lex);
+int ztlex_next_tokens(ztlex_t           *lex,
+                      ztlextok_t        *tokens,
+                      const ztlexinf_t **infos,
+                      int                max)
+{
+  int n;
 
-    goto again;
-  }
+  assert(lex);
+  assert(tokens);
+  assert(infos);
+  assert(max <= ZTLEX_MAXBATCH);
 
-notcomment:
-  /* try the complex tokens first */
-  for (i = 0; i < (int) NELEMS(map); i++)
+  for (n = 0; n < max; n++)
   {
-    int len;
+    if (!ztlex_next_token(lex, &tokens[n], &infos[n]))
+      break;
 
-    len = map[i].fn(lex);
-    if (len == EOF)
-    {
-      return 0;
-    }
-    else if (len)
+    /* runs are double buffered, so a batch may contain only one */
+    if (tokens[n] == ZTTOKEN_INTRUN)
     {
-      *token = map[i].token;
-
-      lex->info.line   = lex->line;
-      lex->info.column = lex->column - len; /* report start of token */
-      lex->info.length = len;
-      memcpy(&lex->info.lexeme[0], lex->lexeme, len + 1);
-      *info = &lex->info;
-      return 1;
+      n++;
+      break;
     }
   }
 
-  /* deal with basic tokens */
-  c = lex->getC(lex);
-  switch (c)
-  {
-    case '(': *token = ZTTOKEN_LPAREN;    break;
-    case ')': *token = ZTTOKEN_RPAREN;    break;
-    case '*': *token = ZTTOKEN_TIMES;     break;
-    case '+': *token = ZTTOKEN_PLUS;      break;
-    case ',': *token = ZTTOKEN_COMMA;     break;
-    case '-': *token = ZTTOKEN_MINUS;     break;
-    case '/': *token = ZTTOKEN_DIVIDE;    break;
-    case ';': *token = ZTTOKEN_SEMICOLON; break;
-    case '=': *token = ZTTOKEN_EQUALS;    break;
-    case '[': *token = ZTTOKEN_LSQBRA;    break;
-    case ']': *token = ZTTOKEN_RSQBRA;    break;
-    case '{': *token = ZTTOKEN_LBRACE;    break;
-    case '}': *token = ZTTOKEN_RBRACE;    break;
-    default:
-      if (c != EOF) {
-        lex->ungetC(c, lex);
-        fprintf(stderr, "Unknown token '%c' at line %d column %d\n", c, lex->line, lex->column);
-      }
-      return 0;
-  }
-
-  lex->info.line   = lex->line;
-  lex->info.column = lex->column - 1; /* report start of token */
-  lex->info.length = 0; /* FIXME: Should basic tokens have any length? */
-  *info = &lex->info;
-  return 1;
+  return n;
 }
 
 /* ----------------------------------------------------------------------- */
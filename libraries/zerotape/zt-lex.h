@@ -7,6 +7,7 @@
 
 /* ----------------------------------------------------------------------- */
 
+/* Longest lexeme accepted from a stream. Memory sources have no limit. */
 #define MAXLEXEME (256)
 
 /* ----------------------------------------------------------------------- */
@@ -17,9 +18,12 @@ typedef int ztlextok_t;
 
 typedef struct ztlexinf
 {
-  int  line, column;
-  int  length;
-  char lexeme[MAXLEXEME];
+  size_t              offset; /* input offset of the token's first character */
+  const char         *lexeme; /* slice of the input - not terminated */
+  int                 length; /* length of 'lexeme' */
+  unsigned int        value;  /* decoded INT, HEX, DOLLARHEX or DECIMAL (x100) */
+  const unsigned int *run;    /* decoded INTRUN values */
+  int                 nrun;
 }
 ztlexinf_t;
 
@@ -33,26 +37,69 @@ typedef void (ztlex_freefn_t)(void *);
 ztlex_t *ztlex_from_file(ztlex_mallocfn_t *mallocfn,
                          ztlex_freefn_t   *freefn,
                    const char             *filename);
+/* Returns NULL if the file can't be mapped, e.g. if it's a pipe. */
+ztlex_t *ztlex_from_mmap(ztlex_mallocfn_t *mallocfn,
+                         ztlex_freefn_t   *freefn,
+                   const char             *filename);
 ztlex_t *ztlex_from_string(ztlex_mallocfn_t *mallocfn,
                            ztlex_freefn_t   *freefn,
                      const char             *string);
+/* The data is lexed in place, so must outlive the lexer. It need not be
+ * terminated. */
+ztlex_t *ztlex_from_buffer(ztlex_mallocfn_t *mallocfn,
+                           ztlex_freefn_t   *freefn,
+                     const char             *data,
+                           size_t            length);
+/* A push lexer is handed its input in chunks by ztlex_feed. */
+ztlex_t *ztlex_for_push(ztlex_mallocfn_t *mallocfn,
+                        ztlex_freefn_t   *freefn);
 void ztlex_destroy(ztlex_t *lex);
 
-/* Returns non-zero if a valid token */
+/* Point a push lexer at the start of a file, so that its block buffer is
+ * reused rather than allocated afresh. Any previous file is closed.
+ * Returns zero if the file can't be opened. */
+int ztlex_open(ztlex_t *lex, const char *filename);
+/* Close the file given to ztlex_open, if any. */
+void ztlex_close(ztlex_t *lex);
+
+/* Returns how many of the 'n' bytes were accepted. Consume tokens to make
+ * space for the rest. */
+size_t ztlex_feed(ztlex_t    *lexer,
+            const void       *bytes,
+                  size_t      n);
+/* Signal that no more input will be fed. */
+void ztlex_finish(ztlex_t *lexer);
+/* Returns non-zero if ztlex_next_token last returned zero because a push
+ * lexer needs more input, rather than because the input ended. */
+int ztlex_starved(const ztlex_t *lexer);
+
+/* Returns non-zero if a valid token. The info remains valid until the call
+ * after next, so a parser may hold on to it while it examines a lookahead
+ * token. */
 int ztlex_next_token(ztlex_t     *lexer,
                      ztlextok_t  *token,
                const ztlexinf_t **info);
 
-/* ----------------------------------------------------------------------- */
-
-typedef int (ixlexfn_t)(ztlex_t *lex);
-
-ixlexfn_t ztlex_isdollarhex;
-ixlexfn_t ztlex_ishex;
-ixlexfn_t ztlex_isdecimal;
-ixlexfn_t ztlex_isinteger;
-ixlexfn_t ztlex_isnil;
-ixlexfn_t ztlex_isname;
+/* Most tokens fetched by one call to ztlex_next_tokens. */
+#define ZTLEX_MAXBATCH (32)
+
+/* Fetch up to 'max' tokens at once, so that they can be handed to the
+ * parser as a batch. A batch ends early after an INTRUN token. Returns the
+ * number of tokens fetched: zero at the end of input, on error, or if a
+ * push lexer is starved. The infos remain valid until the call after
+ * next. */
+int ztlex_next_tokens(ztlex_t           *lexer,
+                      ztlextok_t        *tokens,
+                const ztlexinf_t       **infos,
+                      int                max);
+
+/* Compute the line and column (both from 1) of input offset 'offset'.
+ * This is only intended for diagnostics. For streams only offsets near the
+ * current token can be resolved: others give zero. */
+void ztlex_location(const ztlex_t *lexer,
+                    size_t         offset,
+                    int           *line,
+                    int           *column);
 
 /* ----------------------------------------------------------------------- */
 
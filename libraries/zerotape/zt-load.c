@@ -9,10 +9,68 @@
 
 #include "zt-ast.h"
 #include "zt-driver.h"
+#include "zt-index.h"
 #include "zt-run.h"
 
 /* ----------------------------------------------------------------------- */
 
+/* Hand a copy of any error message in 'errbuf' to the caller. */
+static void zt_keep_syntax(const char *errbuf, char **syntax_error)
+{
+  size_t len;
+
+  if (errbuf[0] == '\0')
+    return;
+
+  len = strlen(errbuf) + 1;
+  *syntax_error = malloc(len);
+  if (*syntax_error)
+    memcpy(*syntax_error, errbuf, len);
+}
+
+/* Run the program in 'ast' (NULL if parsing failed) to load 'structure',
+ * recording the load's counts in 'stats' if it's not NULL. */
+static ztresult_t zt_load_ast(ztast_t           *ast,
+                              char              *errbuf,
+                              const ztstruct_t  *meta,
+                              void              *structure,
+                              const ztregion_t  *regions,
+                              int                nregions,
+                              ztloader_t       **loaders,
+                              int                nloaders,
+                              char             **syntax_error,
+                              ztloadstats_t     *stats)
+{
+  ztresult_t rc;
+
+  if (ast == NULL)
+  {
+    if (stats)
+    {
+      stats->predicted = 0;
+      stats->searched  = 0;
+    }
+    rc = ztresult_PARSE_FAIL;
+    goto exit;
+  }
+
+  rc = zt_run_program(ast,
+                      meta,
+                      regions,
+                      nregions,
+                      loaders,
+                      nloaders,
+                      structure,
+                      errbuf,
+                      stats);
+
+exit:
+  if (rc)
+    zt_keep_syntax(errbuf, syntax_error);
+
+  return rc;
+}
+
 ztresult_t zt_load(const ztstruct_t  *meta,
                    void              *structure,
                    const char        *filename,
@@ -36,39 +94,197 @@ ztresult_t zt_load(const ztstruct_t  *meta,
   *syntax_error = NULL;
 
   ast = ztast_from_file(filename, errbuf);
-  if (ast == NULL)
-  {
-    rc = ztresult_PARSE_FAIL;
-    goto exit;
-  }
 
-  rc = zt_run_program(ast,
-                      meta,
-                      regions,
-                      nregions,
-                      loaders,
-                      nloaders,
-                      structure,
-                      errbuf);
+  rc = zt_load_ast(ast, errbuf,
+                   meta, structure, regions, nregions, loaders, nloaders,
+                   syntax_error, NULL);
 
   ztast_destroy(ast);
 
-exit:
-  if (rc && errbuf[0])
-  {
-    size_t len;
+  return rc;
+}
 
-    len = strlen(errbuf) + 1;
-    *syntax_error = malloc(len);
-    if (*syntax_error)
-      memcpy(*syntax_error, errbuf, len);
-  }
+ztresult_t zt_load_from_buffer(const ztstruct_t  *meta,
+                               void              *structure,
+                               const char        *data,
+                               size_t             length,
+                               const ztregion_t  *regions,
+                               int                nregions,
+                               ztloader_t       **loaders,
+                               int                nloaders,
+                               char             **syntax_error)
+{
+  ztresult_t rc;
+  ztast_t   *ast;
+  char       errbuf[ZTMAXERRBUF] = "";
+
+  assert(meta);
+  assert(structure);
+  assert(data || length == 0);
+  /* regions may be NULL */
+  assert(nregions >= 0);
+  assert(syntax_error);
+
+  *syntax_error = NULL;
+
+  ast = ztast_from_buffer(data, length, errbuf);
+
+  rc = zt_load_ast(ast, errbuf,
+                   meta, structure, regions, nregions, loaders, nloaders,
+                   syntax_error, NULL);
+
+  ztast_destroy(ast);
+
+  return rc;
+}
+
+ztresult_t zt_load_streaming(const ztstruct_t  *meta,
+                             void              *structure,
+                             const char        *filename,
+                             const ztregion_t  *regions,
+                             int                nregions,
+                             ztloader_t       **loaders,
+                             int                nloaders,
+                             char             **syntax_error)
+{
+  ztresult_t rc;
+  ztstream_t stream;
+  char       errbuf[ZTMAXERRBUF] = "";
+
+  assert(meta);
+  assert(structure);
+  assert(filename);
+  /* regions may be NULL */
+  assert(nregions >= 0);
+  assert(syntax_error);
+
+  *syntax_error = NULL;
+
+  rc = zt_stream_init(&stream,
+                      meta, structure, regions, nregions, loaders, nloaders);
+  if (rc == ztresult_OK && !ztparser_stream_file(filename, &stream, errbuf))
+    rc = stream.rc ? stream.rc : ztresult_PARSE_FAIL;
+
+  zt_stream_fini(&stream);
+
+  if (rc)
+    zt_keep_syntax(errbuf, syntax_error);
+
+  return rc;
+}
+
+ztresult_t ztparser_finish(ztparser_t        *ctx,
+                           const ztstruct_t  *meta,
+                           void              *structure,
+                           const ztregion_t  *regions,
+                           int                nregions,
+                           ztloader_t       **loaders,
+                           int                nloaders,
+                           char             **syntax_error)
+{
+  ztresult_t rc;
+  ztast_t   *ast;
+  char       errbuf[ZTMAXERRBUF] = "";
+
+  assert(ctx);
+  assert(meta);
+  assert(structure);
+  /* regions may be NULL */
+  assert(nregions >= 0);
+  assert(syntax_error);
+
+  *syntax_error = NULL;
+
+  ast = ztast_from_parser(ctx, errbuf);
+
+  rc = zt_load_ast(ast, errbuf,
+                   meta, structure, regions, nregions, loaders, nloaders,
+                   syntax_error, NULL);
+
+  ztast_destroy(ast);
 
   return rc;
 }
 
 /* ----------------------------------------------------------------------- */
 
+struct zt_loader
+{
+  ztparser_t    *parser;
+  ztloadstats_t  stats; /* counts from the most recent load */
+};
+
+zt_loader_t *zt_loader_create(void)
+{
+  zt_loader_t *loader;
+
+  loader = malloc(sizeof(*loader));
+  if (loader == NULL)
+    return NULL;
+
+  loader->parser = ztparser_create_reusable();
+  if (loader->parser == NULL)
+  {
+    free(loader);
+    return NULL;
+  }
+
+  loader->stats.predicted = 0;
+  loader->stats.searched  = 0;
+
+  return loader;
+}
+
+ztresult_t zt_loader_load(zt_loader_t       *loader,
+                          const ztstruct_t  *meta,
+                          void              *structure,
+                          const char        *filename,
+                          const ztregion_t  *regions,
+                          int                nregions,
+                          ztloader_t       **loaders,
+                          int                nloaders,
+                          char             **syntax_error)
+{
+  ztast_t *ast;
+  char     errbuf[ZTMAXERRBUF] = "";
+
+  assert(loader);
+  assert(meta);
+  assert(structure);
+  assert(filename);
+  /* regions may be NULL */
+  assert(nregions >= 0);
+  assert(syntax_error);
+
+  *syntax_error = NULL;
+
+  /* the AST belongs to the parser and is freed by its next use */
+  ast = ztparser_parse_file(loader->parser, filename, errbuf);
+
+  return zt_load_ast(ast, errbuf,
+                     meta, structure, regions, nregions, loaders, nloaders,
+                     syntax_error, &loader->stats);
+}
+
+void zt_loader_stats(const zt_loader_t *loader, ztloadstats_t *stats)
+{
+  assert(loader);
+  assert(stats);
+
+  *stats = loader->stats;
+}
+
+void zt_loader_destroy(zt_loader_t *loader)
+{
+  if (loader == NULL)
+    return;
+
+  ztparser_delete(loader->parser);
+  free(loader);
+}
+
+/* ----------------------------------------------------------------------- */
+
 void zt_freesyntax(char *syntax_error)
 {
   free(syntax_error);
@@ -0,0 +1,277 @@
+/* zt-plan.c
+ *
+ * Load plans.
+ */
+
+#include <limits.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "zerotape/zerotape.h"
+
+#include "zt-index.h"
+
+#include "zt-plan.h"
+
+/* ----------------------------------------------------------------------- */
+
+/* Plans compiled so far. There's one per schema, so a list will do. */
+static ztplan_t *plans;
+
+/* ----------------------------------------------------------------------- */
+
+static int zt_plan_struct(ztplan_t *plan, const ztstruct_t *meta);
+
+/* Returns the index of 'n' new instructions, or -1 if out of memory. */
+static int zt_plan_alloc(ztplan_t *plan, int n)
+{
+  int first;
+
+  if (plan->ninsns + n > plan->ninsnsalloced)
+  {
+    int       alloced;
+    ztinsn_t *newinsns;
+
+    alloced = plan->ninsnsalloced * 2; /* doubling strategy */
+    if (alloced < 16)
+      alloced = 16;
+    while (alloced < plan->ninsns + n)
+      alloced *= 2;
+    newinsns = realloc(plan->insns, alloced * sizeof(*newinsns));
+    if (newinsns == NULL)
+      return -1;
+
+    plan->insns         = newinsns;
+    plan->ninsnsalloced = alloced;
+  }
+
+  first = plan->ninsns;
+  plan->ninsns += n;
+  return first;
+}
+
+/* Returns the slot for region 'id', or -1 if out of memory. */
+static int zt_plan_region(ztplan_t *plan, ztregionidx_t id)
+{
+  int r;
+
+  for (r = 0; r < plan->nregionids; r++)
+    if (plan->regionids[r] == id)
+      return r;
+
+  if (plan->nregionids == plan->nregionidsalloced)
+  {
+    int            alloced;
+    ztregionidx_t *newids;
+
+    alloced = plan->nregionidsalloced ? plan->nregionidsalloced * 2 : 4;
+    newids = realloc(plan->regionids, alloced * sizeof(*newids));
+    if (newids == NULL)
+      return -1;
+
+    plan->regionids         = newids;
+    plan->nregionidsalloced = alloced;
+  }
+
+  plan->regionids[plan->nregionids] = id;
+  return plan->nregionids++;
+}
+
+/* Translates one field. Returns zero if out of memory. */
+static int zt_plan_field(ztplan_t *plan, int i, const ztfield_t *field)
+{
+  ztinsn_t insn;
+  int      sub;
+
+  insn.op       = ztop_UNSUPPORTED;
+  insn.indirect = 0;
+  insn.count    = field->nelems;
+  insn.offset   = field->offset;
+  insn.elsz     = 0;
+  insn.max      = 0;
+  insn.arg      = 0;
+  insn.ptr      = NULL;
+
+  switch (field->type)
+  {
+  case zttype_ucharptr:
+    insn.indirect = 1;
+    /* FALLTHROUGH */
+  case zttype_uchar:
+    insn.op   = (field->nelems == 1) ? ztop_UCHAR : ztop_UCHARS;
+    insn.elsz = sizeof(ztuchar_t);
+    insn.max  = UCHAR_MAX;
+    break;
+
+  case zttype_ushortptr:
+    insn.indirect = 1;
+    /* FALLTHROUGH */
+  case zttype_ushort:
+    insn.op   = (field->nelems == 1) ? ztop_USHORT : ztop_USHORTS;
+    insn.elsz = sizeof(ztushort_t);
+    insn.max  = USHRT_MAX;
+    break;
+
+  case zttype_uintptr:
+    insn.indirect = 1;
+    /* FALLTHROUGH */
+  case zttype_uint:
+    insn.op   = (field->nelems == 1) ? ztop_UINT : ztop_UINTS;
+    insn.elsz = sizeof(ztuint_t);
+    insn.max  = UINT_MAX;
+    break;
+
+  case zttype_structptr:
+    insn.indirect = 1;
+    /* FALLTHROUGH */
+  case zttype_struct:
+    /* this may move plan->insns */
+    sub = zt_plan_struct(plan, field->metadata);
+    if (sub < 0)
+      return 0;
+    insn.op   = (field->nelems == 1) ? ztop_STRUCT : ztop_STRUCTS;
+    insn.elsz = field->size; /* field->size is sizeof(struct) */
+    insn.arg  = sub;
+    break;
+
+  case zttype_staticarrayidx:
+    if (field->nelems != 1)
+      break;
+    insn.op   = ztop_STATICINDEX;
+    insn.elsz = field->array->length / field->array->nelems; /* field->array->length is total size of array */
+    insn.arg  = field->array->nelems;
+    insn.ptr  = field->array->base;
+    break;
+
+  case zttype_arrayidx:
+    /* multiple elements are refused when loading, but only once the region
+     * is known to exist */
+    insn.op  = ztop_REGIONINDEX;
+    insn.arg = zt_plan_region(plan, field->regionid);
+    if (insn.arg < 0)
+      return 0;
+    break;
+
+  case zttype_version:
+    if (field->nelems != 1)
+      break;
+    insn.op = ztop_VERSION;
+    break;
+
+  case zttype_custom:
+    if (field->nelems != 1)
+      break;
+    insn.op  = ztop_CUSTOM;
+    insn.arg = field->typeidx;
+    break;
+  }
+
+  plan->insns[i] = insn;
+  return 1;
+}
+
+/* Compiles 'meta' into 'plan', unless it's already there. Returns the index
+ * of its header, or -1 if out of memory. */
+static int zt_plan_struct(ztplan_t *plan, const ztstruct_t *meta)
+{
+  int h;
+  int f;
+
+  /* a structure may be used by many fields, or even by itself */
+  for (h = 0; h < plan->ninsns; h += 1 + plan->insns[h].count)
+    if (plan->insns[h].ptr == meta)
+      return h;
+
+  if (!zt_index_prepare(meta))
+    return -1;
+
+  h = zt_plan_alloc(plan, 1 + meta->nfields);
+  if (h < 0)
+    return -1;
+
+  plan->insns[h].op       = ztop_HEADER;
+  plan->insns[h].indirect = 0;
+  plan->insns[h].count    = meta->nfields;
+  plan->insns[h].offset   = 0;
+  plan->insns[h].elsz     = 0;
+  plan->insns[h].max      = 0;
+  plan->insns[h].arg      = 0;
+  plan->insns[h].ptr      = meta;
+
+  for (f = 0; f < meta->nfields; f++)
+    if (!zt_plan_field(plan, h + 1 + f, &meta->fields[f]))
+      return -1;
+
+  return h;
+}
+
+static void zt_plan_destroy(ztplan_t *plan)
+{
+  if (plan == NULL)
+    return;
+
+  free(plan->insns);
+  free(plan->regionids);
+  free(plan);
+}
+
+static ztplan_t *zt_plan_compile(const ztstruct_t *meta)
+{
+  ztplan_t *plan;
+
+  plan = calloc(1, sizeof(*plan));
+  if (plan == NULL)
+    return NULL;
+
+  if (zt_plan_struct(plan, meta) < 0)
+  {
+    zt_plan_destroy(plan);
+    return NULL;
+  }
+
+  return plan;
+}
+
+const ztplan_t *zt_plan_get(const ztstruct_t *meta)
+{
+  ztplan_t *plan;
+
+  for (plan = plans; plan; plan = plan->next)
+    if (plan->insns[0].ptr == meta)
+      return plan;
+
+  plan = zt_plan_compile(meta);
+  if (plan == NULL)
+    return NULL;
+
+  plan->next = plans;
+  plans = plan;
+
+  return plan;
+}
+
+/* ----------------------------------------------------------------------- */
+
+ztresult_t zt_prepare(const ztstruct_t *meta)
+{
+  return zt_plan_get(meta) ? ztresult_OK : ztresult_OOM;
+}
+
+void zt_release_prepared(void)
+{
+  ztplan_t *plan;
+  ztplan_t *next;
+
+  for (plan = plans; plan; plan = next)
+  {
+    next = plan->next;
+    zt_plan_destroy(plan);
+  }
+  plans = NULL;
+
+  zt_index_release();
+}
+
+/* ----------------------------------------------------------------------- */
+
+/* vim: set ts=8 sts=2 sw=2 et: */
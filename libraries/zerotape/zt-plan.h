@@ -0,0 +1,86 @@
+/* zt-plan.h
+ *
+ * Load plans.
+ */
+
+#ifndef ZT_PLAN_H
+#define ZT_PLAN_H
+
+#include <stddef.h>
+
+#include "zerotape/zerotape.h"
+
+/* A load plan is a ztstruct_t tree compiled into a flat array of
+ * instructions. Each structure in the tree becomes a header followed by one
+ * instruction per field, in the same order as its fields[], with all that
+ * the loader needs worked out up front: where each value goes, how wide its
+ * elements are, the largest value allowed, and which nested structure or
+ * region slot it refers to. */
+
+typedef enum ztop
+{
+  ztop_HEADER,      /* begins a structure: 'ptr' is its ztstruct_t and
+                       'count' its number of fields */
+  ztop_UCHAR,       /* single integers */
+  ztop_USHORT,
+  ztop_UINT,
+  ztop_UCHARS,      /* arrays of integers */
+  ztop_USHORTS,
+  ztop_UINTS,
+  ztop_STRUCT,      /* single structure: 'arg' is the index of its header */
+  ztop_STRUCTS,     /* array of structures, likewise */
+  ztop_STATICINDEX, /* pointer into 'ptr', an array of 'arg' elements */
+  ztop_REGIONINDEX, /* pointer into the region in slot 'arg' */
+  ztop_VERSION,
+  ztop_CUSTOM,      /* 'arg' is the custom ID */
+  ztop_UNSUPPORTED  /* a field which can't be loaded */
+}
+ztop_t;
+
+typedef struct ztinsn
+{
+  unsigned char  op;       /* ztop_t */
+  unsigned char  indirect; /* the field holds a pointer to its storage */
+  int            count;    /* number of elements */
+  size_t         offset;   /* of the field within its structure */
+  size_t         elsz;     /* bytes per element */
+  unsigned int   max;      /* largest integer which can be stored */
+  int            arg;
+  const void    *ptr;
+}
+ztinsn_t;
+
+typedef struct ztplan
+{
+  struct ztplan   *next;       /* next plan in the registry */
+
+  ztinsn_t        *insns;      /* the root structure's header comes first */
+  int              ninsns;
+  int              ninsnsalloced;
+
+  ztregionidx_t   *regionids;  /* the region ID of each slot */
+  int              nregionids;
+  int              nregionidsalloced;
+}
+ztplan_t;
+
+/* The fields of the structure whose header is at 'header'. */
+#define ZTPLAN_META(PLAN, HEADER) \
+  ((const ztstruct_t *) (PLAN)->insns[HEADER].ptr)
+#define ZTPLAN_FIELD(PLAN, HEADER, F) \
+  (&(PLAN)->insns[(HEADER) + 1 + (F)])
+
+/**
+ * Return the load plan for 'meta', compiling it on first use. Plans are kept
+ * in a registry keyed by the address of 'meta' until zt_release_prepared is
+ * called.
+ *
+ * \param meta description of the structure to load
+ *
+ * \return plan, or NULL if out of memory
+ */
+const ztplan_t *zt_plan_get(const ztstruct_t *meta);
+
+#endif /* ZT_PLAN_H */
+
+/* vim: set ts=8 sts=2 sw=2 et: */
@@ -0,0 +1,93 @@
+/* zt-region.c
+ *
+ * Region lookup tables.
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "zerotape/zerotape.h"
+
+#include "zt-hash.h"
+
+#include "zt-region.h"
+
+/* ----------------------------------------------------------------------- */
+
+/* Up to this many regions are searched linearly. */
+#define ZTREGION_MINREGIONS (8)
+
+/* ----------------------------------------------------------------------- */
+
+void zt_regiontable_init(ztregiontable_t  *table,
+                         const ztregion_t *regions,
+                         int               nregions)
+{
+  unsigned int nslots;
+  int          r;
+
+  table->regions  = regions;
+  table->nregions = nregions;
+  table->mask     = 0;
+  table->slots    = NULL;
+
+  if (nregions <= ZTREGION_MINREGIONS)
+    return;
+
+  /* keep the table at most half full */
+  for (nslots = ZTREGION_MINREGIONS * 2; nslots < (unsigned int) nregions * 2; nslots *= 2)
+    ;
+
+  table->slots = calloc(nslots, sizeof(*table->slots));
+  if (table->slots == NULL)
+    return; /* search linearly instead */
+
+  table->mask = nslots - 1;
+
+  /* a duplicated ID keeps the slot of its first region, which is the one
+   * the linear search would return */
+  for (r = 0; r < nregions; r++)
+  {
+    unsigned int j;
+
+    for (j = zt_hash_pointer(regions[r].id); table->slots[j & table->mask]; j++)
+      if (regions[table->slots[j & table->mask] - 1].id == regions[r].id)
+        break;
+    if (table->slots[j & table->mask] == 0)
+      table->slots[j & table->mask] = r + 1;
+  }
+}
+
+void zt_regiontable_fini(ztregiontable_t *table)
+{
+  free(table->slots);
+  table->slots = NULL;
+}
+
+const ztarray_t *zt_regiontable_find(const ztregiontable_t *table,
+                                     ztregionidx_t          id)
+{
+  unsigned int j;
+  int          r;
+
+  if (table->slots == NULL)
+  {
+    for (r = 0; r < table->nregions; r++)
+      if (table->regions[r].id == id)
+        return &table->regions[r].spec;
+    return NULL;
+  }
+
+  for (j = zt_hash_pointer(id); ; j++)
+  {
+    r = table->slots[j & table->mask];
+    if (r == 0)
+      return NULL;
+    if (table->regions[r - 1].id == id)
+      return &table->regions[r - 1].spec;
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+/* vim: set ts=8 sts=2 sw=2 et: */
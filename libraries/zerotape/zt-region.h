@@ -0,0 +1,58 @@
+/* zt-region.h
+ *
+ * Region lookup tables.
+ */
+
+#ifndef ZT_REGION_H
+#define ZT_REGION_H
+
+#include "zerotape/zerotape.h"
+
+/* The regions given to a load or save, hashed by their IDs. Tables are
+ * built once per call so that each zttype_arrayidx field costs a single
+ * probe rather than a scan of the regions. */
+typedef struct ztregiontable
+{
+  const ztregion_t *regions;
+  int               nregions;
+  unsigned int      mask;  /* number of slots - 1 */
+  int              *slots; /* index into regions + 1, or 0 if empty; or NULL
+                              if searched linearly */
+}
+ztregiontable_t;
+
+/**
+ * Build a region table.
+ *
+ * If memory is short the table falls back to searching 'regions'
+ * linearly, so this can't fail.
+ *
+ * \param table table to initialise
+ * \param regions runtime heap array specs - kept, not copied
+ * \param nregions number of heap array specs
+ */
+void zt_regiontable_init(ztregiontable_t  *table,
+                         const ztregion_t *regions,
+                         int               nregions);
+
+/**
+ * Discard a region table.
+ *
+ * \param table table to finalise
+ */
+void zt_regiontable_fini(ztregiontable_t *table);
+
+/**
+ * Find a region by ID.
+ *
+ * \param table table to search
+ * \param id region ID
+ *
+ * \return description of the region's heap array, or NULL if not found
+ */
+const ztarray_t *zt_regiontable_find(const ztregiontable_t *table,
+                                     ztregionidx_t          id);
+
+#endif /* ZT_REGION_H */
+
+/* vim: set ts=8 sts=2 sw=2 et: */
@@ -11,6 +11,9 @@
 
 #include "zt-driver.h"
 #include "zt-ast.h"
+#include "zt-index.h"
+#include "zt-plan.h"
+#include "zt-region.h"
 
 #include "zt-run.h"
 
@@ -24,16 +27,36 @@
 
 /* ----------------------------------------------------------------------- */
 
+/** Find the field assigned to by 'name', counting whether the prediction
+ * that it follows the last field assigned was right. */
+static int zt_exec_lookup(ztexec_t         *exec,
+                          const ztstruct_t *meta,
+                          int               lastfield,
+                          const char       *name,
+                          size_t            length)
+{
+  int f;
+
+  f = zt_index_lookup_next(meta, lastfield, name, length);
+
+  /* a search can't find the predicted field, as the prediction would
+   * have matched it first */
+  if (f >= 0 && f == lastfield + 1)
+    exec->stats.predicted++;
+  else
+    exec->stats.searched++;
+
+  return f;
+}
+
+/* ----------------------------------------------------------------------- */
+
 /** Run the supplied list of statements against the given state structure
- * defined in 'meta'. */
-static ztresult_t zt_run_statements(const ztast_statement_t *statements,
-                                    const ztstruct_t        *meta,
-                                    const ztregion_t        *regions,
-                                    int                      nregions,
-                                    ztloader_t             **loaders,
-                                    int                      nloaders,
-                                    void                    *structure,
-                                    char                    *errbuf);
+ * defined in the plan at 'header'. */
+static ztresult_t zt_run_statements(ztexec_t      *exec,
+                                    int            header,
+                                    ztast_index_t  statements,
+                                    void          *structure);
 
 /* ----------------------------------------------------------------------- */
 
@@ -87,423 +110,279 @@ static ztresult_t zt_mksyntax(char *errbuf, ztsyntaxerr_t e)
 /** Point to the specified value in state. */
 #define PVAL(STATE, OFFSET) ((void *)((char *) STATE + OFFSET))
 
-/** Handle a single integer field, or array of. */
-#define DO_INLINE(TYPE, MAX)                                                 \
-  do {                                                                       \
-    const ztast_expr_t *expr = assignment->expr;                             \
-                                                                             \
-    if (field->nelems == 1) { /* expecting a single element */               \
-      const ztast_value_t *value;                                            \
-      TYPE                *rawvalue;                                         \
-      unsigned int         integer;                                          \
-                                                                             \
-      if (expr->type != ZTEXPR_VALUE)                                        \
-        return zt_mksyntax(errbuf, ztsyntx_NEED_VALUE);                      \
-      value = expr->data.value;                                              \
-      if (value->type != ZTVAL_INTEGER)                                      \
-        return zt_mksyntax(errbuf, ztsyntx_NEED_INTEGER);                    \
-      integer = value->data.integer;                                         \
-      if (integer > MAX)                                                     \
-        return zt_mksyntax(errbuf, ztsyntx_VALUE_RANGE);                     \
-                                                                             \
-      rawvalue = PVAL(structure, field->offset);                             \
-      *rawvalue = integer;                                                   \
-    } else { /* expecting an array */                                        \
-      const ztast_intarray_t      *intarr;                                   \
-      const ztast_intarrayinner_t *inner;                                    \
-      TYPE                        *rawarr;                                   \
-      int                          i;                                        \
-                                                                             \
-      if (expr->type != ZTEXPR_INTARRAY)                                     \
-        return zt_mksyntax(errbuf, ztsyntx_NEED_INTEGERARRAY);               \
-      intarr = expr->data.intarray;                                          \
-      inner = intarr->inner;                                                 \
-      if (inner != NULL) {                                                   \
-        rawarr = PVAL(structure, field->offset);                             \
-        for (i = 0; i < inner->nused; i++) {                                 \
-          unsigned int integer = inner->ints[i];                             \
-          if (integer > MAX)                                                 \
-            return zt_mksyntax(errbuf, ztsyntx_VALUE_RANGE);                 \
-          rawarr[i] = integer;                                               \
-        }                                                                    \
-      }                                                                      \
-    }                                                                        \
-  } while (0)
+/** Point to the storage for 'insn' within 'structure'. */
+static void *zt_insn_storage(const ztinsn_t *insn, void *structure)
+{
+  void *p = PVAL(structure, insn->offset);
 
-/** Handle a pointer to single integer field, or array of. */
-#define DO_POINTER(TYPE, MAX)                                                \
+  return insn->indirect ? *(void **) p : p;
+}
+
+/** Store a run of integers. */
+#define STORE_INTS(TYPE)                                                     \
   do {                                                                       \
-    const ztast_expr_t *expr = assignment->expr;                             \
-                                                                             \
-    if (field->nelems == 1) { /* expecting a single element */               \
-      const ztast_value_t *value;                                            \
-      TYPE               **prawvalue;                                        \
-      TYPE                *rawvalue;                                         \
-      unsigned int         integer;                                          \
+    TYPE *rawarr = (TYPE *) storage + first;                                 \
                                                                              \
-      if (expr->type != ZTEXPR_VALUE)                                        \
-        return zt_mksyntax(errbuf, ztsyntx_NEED_VALUE);                      \
-      value = expr->data.value;                                              \
-      if (value->type != ZTVAL_INTEGER)                                      \
-        return zt_mksyntax(errbuf, ztsyntx_NEED_INTEGER);                    \
-      integer = value->data.integer;                                         \
-      if (integer > MAX)                                                     \
+    for (i = 0; i < n; i++) {                                                \
+      if (values[i] > insn->max)                                             \
         return zt_mksyntax(errbuf, ztsyntx_VALUE_RANGE);                     \
-                                                                             \
-      prawvalue = PVAL(structure, field->offset);                            \
-      rawvalue  = *prawvalue;                                                \
-      *rawvalue = integer;                                                   \
-    } else { /* expecting an array */                                        \
-      const ztast_intarray_t      *intarr;                                   \
-      const ztast_intarrayinner_t *inner;                                    \
-      TYPE                       **prawarr;                                  \
-      TYPE                        *rawarr;                                   \
-      int                          i;                                        \
-                                                                             \
-      if (expr->type != ZTEXPR_INTARRAY)                                     \
-        return zt_mksyntax(errbuf, ztsyntx_NEED_INTEGERARRAY);               \
-      intarr = expr->data.intarray;                                          \
-      inner = intarr->inner;                                                 \
-      if (inner != NULL) {                                                   \
-        prawarr = PVAL(structure, field->offset);                            \
-        rawarr = *prawarr;                                                   \
-        for (i = 0; i < inner->nused; i++) {                                 \
-          unsigned int integer = inner->ints[i];                             \
-          if (integer > MAX)                                                 \
-            return zt_mksyntax(errbuf, ztsyntx_VALUE_RANGE);                 \
-          rawarr[i] = integer;                                               \
-        }                                                                    \
-      }                                                                      \
+      rawarr[i] = (TYPE) values[i];                                          \
     }                                                                        \
   } while (0)
 
 /**
- * Execute an assignment statement.
+ * Store integers into an integer field.
  *
- * \param assignment assignment statement to execute
- * \param meta description of 'structure'
- * \param regions runtime heap array specs
- * \param nregions number of heap array specs
- * \param loaders array of loader functions - one per custom ID
- * \param nloaders number of loader functions
- * \param structure structure to populate
- * \param syntax_error error message if (result != ztresult_OK), else NULL
+ * \param insn instruction for the field
+ * \param storage storage for the field
+ * \param first index of the first element to store
+ * \param values values to store
+ * \param n number of values
+ * \param errbuf buffer for error message(s)
  */
-static ztresult_t zt_do_assignment(const ztast_assignment_t *assignment,
-                                   const ztstruct_t         *meta,
-                                   const ztregion_t         *regions,
-                                   int                       nregions,
-                                   ztloader_t              **loaders,
-                                   int                       nloaders,
-                                   void                     *structure,
-                                   char                     *errbuf)
+static ztresult_t zt_store_ints(const ztinsn_t     *insn,
+                                void               *storage,
+                                int                 first,
+                                const unsigned int *values,
+                                int                 n,
+                                char               *errbuf)
 {
-  const char      *name;
-  int              f;
-  const ztfield_t *field;
-
-  name = assignment->id->name;
-  logf(("assignment to field '%s'\n", name));
-  for (f = 0; f < meta->nfields; f++)
-    if (strcmp(meta->fields[f].name, name) == 0)
-      break;
-  if (f == meta->nfields)
-    zt_mksyntax(errbuf, ztsyntx_UNKNOWN_FIELD);
+  int i;
 
-  field = &meta->fields[f];
-  assert(field->nelems >= 1);
-  switch (field->type)
+  switch (insn->op)
   {
-  case zttype_uchar:
-    DO_INLINE(ztuchar_t, UCHAR_MAX);
-    break;
-  case zttype_ucharptr:
-    DO_POINTER(ztuchar_t, UCHAR_MAX);
-    break;
-  case zttype_ushort:
-    DO_INLINE(ztushort_t, USHRT_MAX);
+  case ztop_UCHAR:
+  case ztop_UCHARS:
+    STORE_INTS(ztuchar_t);
     break;
-  case zttype_ushortptr:
-    DO_POINTER(ztushort_t, USHRT_MAX);
+  case ztop_USHORT:
+  case ztop_USHORTS:
+    STORE_INTS(ztushort_t);
     break;
-  case zttype_uint:
-    DO_INLINE(ztuint_t, UINT_MAX);
-    break;
-  case zttype_uintptr:
-    DO_POINTER(ztuint_t, UINT_MAX);
+  case ztop_UINT:
+  case ztop_UINTS:
+    STORE_INTS(ztuint_t);
     break;
+  default:
+    return zt_mksyntax(errbuf, ztsyntx_NEED_INTEGERARRAY);
+  }
 
-  case zttype_struct:
-    if (field->nelems == 1) /* expecting a single element */
-    {
-      ztresult_t          rc;
-      const ztast_expr_t *scopeexpr;
-      void               *rawstruct;
-
-      scopeexpr = assignment->expr;
-      if (scopeexpr->type != ZTEXPR_SCOPE)
-        return zt_mksyntax(errbuf, ztsyntx_NEED_SCOPE);
-
-      rawstruct = PVAL(structure, field->offset);
-
-      rc = zt_run_statements(scopeexpr->data.scope->statements,
-                             field->metadata,
-                             regions,
-                             nregions,
-                             loaders,
-                             nloaders,
-                             rawstruct,
-                             errbuf);
-      if (rc)
-        return rc;
-    }
-    else /* expecting an array */
-    {
-      const ztast_expr_t            *arrayexpr;
-      const ztast_scopearrayinner_t *inner;
-      void                          *rawstruct;
-      int                            i;
+  return ztresult_OK;
+}
 
-      arrayexpr = assignment->expr;
-      if (arrayexpr->type != ZTEXPR_SCOPEARRAY)
-        return zt_mksyntax(errbuf, ztsyntx_NEED_SCOPEARRAY);
+/** Returns the array in the given region slot, finding it on first use. */
+static const ztarray_t *zt_exec_region(ztexec_t *exec, int slot)
+{
+  if (exec->resolved[slot] == NULL)
+    exec->resolved[slot] = zt_regiontable_find(&exec->regions,
+                                               exec->plan->regionids[slot]);
+  return exec->resolved[slot];
+}
 
-      inner = arrayexpr->data.scopearray->inner;
-      if (inner == NULL)
-        return zt_mksyntax(errbuf, ztsyntx_NEED_VALUE);
+/**
+ * Point a field at an element of an array, or at nothing.
+ *
+ * \param expr index of the element, or nil
+ * \param base start of the array
+ * \param nelems number of elements in the array
+ * \param elsz size of an element
+ * \param pvalue field to assign
+ * \param errbuf buffer for error message(s)
+ */
+static ztresult_t zt_do_index(const ztast_exprnode_t  *expr,
+                              const void              *base,
+                              int                      nelems,
+                              size_t                   elsz,
+                              void                   **pvalue,
+                              char                    *errbuf)
+{
+  int index;
 
-      /* Note: This will initialise as many entries as data is provided for,
-       *       but not fault if any are missing. */
+  if (expr->type != ZTEXPR_VALUE)
+    return zt_mksyntax(errbuf, ztsyntx_NEED_VALUE);
 
-      rawstruct = PVAL(structure, field->offset);
+  switch (expr->valuetype)
+  {
+  case ZTVAL_INTEGER:
+    index = expr->u.integer;
+    if (index < 0 || index >= nelems)
+      return zt_mksyntax(errbuf, ztsyntx_VALUE_RANGE);
 
-      for (i = 0; i < inner->nused; i++)
-      {
-        const ztast_scope_t *scope;
-        const size_t         elsz = field->size; /* field->size is sizeof(struct) */
-        ztresult_t           rc;
-
-        scope = inner->scopes[i];
-
-        rc = zt_run_statements(scope->statements,
-                               field->metadata,
-                               regions,
-                               nregions,
-                               loaders,
-                               nloaders,
-                      (char *) rawstruct + i * elsz,
-                               errbuf);
-        if (rc)
-          return rc;
-      }
-    }
+    *pvalue = (char *) base + index * elsz;
     break;
 
-  case zttype_structptr:
-    if (field->nelems == 1) /* expecting a single element */
-    {
-      ztresult_t          rc;
-      const ztast_expr_t *scopeexpr;
-      void              **prawstruct;
-      void               *rawstruct;
-
-      scopeexpr = assignment->expr;
-      if (scopeexpr->type != ZTEXPR_SCOPE)
-        return zt_mksyntax(errbuf, ztsyntx_NEED_SCOPE);
-
-      prawstruct = PVAL(structure, field->offset);
-      rawstruct = *prawstruct;
-
-      rc = zt_run_statements(scopeexpr->data.scope->statements,
-                             field->metadata,
-                             regions,
-                             nregions,
-                             loaders,
-                             nloaders,
-                             rawstruct,
-                             errbuf);
-      if (rc)
-        return rc;
-    }
-    else /* expecting an array */
-    {
-      const ztast_expr_t            *arrayexpr;
-      const ztast_scopearrayinner_t *inner;
-      void                         **prawstruct;
-      void                          *rawstruct;
-      int                            i;
-
-      arrayexpr = assignment->expr;
-      if (arrayexpr->type != ZTEXPR_SCOPEARRAY)
-        return zt_mksyntax(errbuf, ztsyntx_NEED_SCOPEARRAY);
+  case ZTVAL_NIL:
+    *pvalue = NULL;
+    break;
 
-      inner = arrayexpr->data.scopearray->inner;
-      if (inner == NULL)
-        return zt_mksyntax(errbuf, ztsyntx_NEED_VALUE);
+  default:
+    return zt_mksyntax(errbuf, ztsyntx_UNEXPECTED_VALUE_TYPE);
+  }
 
-      /* Note: This will initialise as many entries as data is provided for,
-       *       but not fault if any are missing. */
+  return ztresult_OK;
+}
 
-      prawstruct = PVAL(structure, field->offset);
-      rawstruct = *prawstruct;
+/**
+ * Assign an expression to a field.
+ *
+ * \param exec execution state
+ * \param insn instruction for the field to assign to
+ * \param expr expression to assign
+ * \param structure structure containing the field
+ */
+static ztresult_t zt_do_insn(ztexec_t               *exec,
+                             const ztinsn_t         *insn,
+                             const ztast_exprnode_t *expr,
+                             void                   *structure)
+{
+  char *errbuf = exec->errbuf;
 
-      for (i = 0; i < inner->nused; i++)
-      {
-        const ztast_scope_t *scope;
-        const size_t         elsz = field->size; /* field->size is sizeof(struct) */
-        ztresult_t           rc;
-
-        scope = inner->scopes[i];
-
-        rc = zt_run_statements(scope->statements,
-                               field->metadata,
-                               regions,
-                               nregions,
-                               loaders,
-                               nloaders,
-                      (char *) rawstruct + i * elsz,
-                               errbuf);
-        if (rc)
-          return rc;
-      }
+  switch (insn->op)
+  {
+  case ztop_UCHAR:
+  case ztop_USHORT:
+  case ztop_UINT:
+    {
+      unsigned int integer;
+
+      if (expr->type != ZTEXPR_VALUE)
+        return zt_mksyntax(errbuf, ztsyntx_NEED_VALUE);
+      if (expr->valuetype != ZTVAL_INTEGER)
+        return zt_mksyntax(errbuf, ztsyntx_NEED_INTEGER);
+
+      integer = expr->u.integer;
+      return zt_store_ints(insn,
+                           zt_insn_storage(insn, structure),
+                           0,
+                          &integer,
+                           1,
+                           errbuf);
     }
-    break;
 
-  case zttype_staticarrayidx:
-    assert(field->array);
-    assert(field->regionid == ZT_NO_REGIONID);
-    if (field->nelems == 1) /* expecting a single element */
+  case ztop_UCHARS:
+  case ztop_USHORTS:
+  case ztop_UINTS:
+    if (expr->type != ZTEXPR_INTARRAY)
+      return zt_mksyntax(errbuf, ztsyntx_NEED_INTEGERARRAY);
+    if (expr->u.ints.count == 0)
+      break;
+    if (expr->u.ints.count > (unsigned int) insn->count)
+      return zt_mksyntax(errbuf, ztsyntx_VALUE_RANGE);
+
+    return zt_store_ints(insn,
+                         zt_insn_storage(insn, structure),
+                         0,
+                         exec->ast->ints + expr->u.ints.first,
+                         expr->u.ints.count,
+                         errbuf);
+
+  case ztop_STRUCT:
+    if (expr->type != ZTEXPR_SCOPE)
+      return zt_mksyntax(errbuf, ztsyntx_NEED_SCOPE);
+
+    return zt_run_statements(exec,
+                             insn->arg,
+                             expr->u.statements,
+                             zt_insn_storage(insn, structure));
+
+  case ztop_STRUCTS:
     {
-      const size_t        elsz = field->array->length / field->array->nelems; /* field->array->length is total size of array */
-      const ztast_expr_t *assignmentexpr;
-      void              **prawvalue;
-      int                 index;
+      char          *rawstruct;
+      ztast_index_t  scope;
+      ztresult_t     rc;
 
-      assignmentexpr = assignment->expr;
-      if (assignmentexpr->type != ZTEXPR_VALUE)
+      if (expr->type != ZTEXPR_SCOPEARRAY)
+        return zt_mksyntax(errbuf, ztsyntx_NEED_SCOPEARRAY);
+      if (expr->u.scopes.count == 0)
         return zt_mksyntax(errbuf, ztsyntx_NEED_VALUE);
+      if (expr->u.scopes.count > (unsigned int) insn->count)
+        return zt_mksyntax(errbuf, ztsyntx_VALUE_RANGE);
 
-      prawvalue = PVAL(structure, field->offset);
+      /* Note: This will initialise as many entries as data is provided for,
+       *       but not fault if any are missing. */
 
-      switch (assignmentexpr->data.value->type)
+      rawstruct = zt_insn_storage(insn, structure);
+      for (scope = expr->u.scopes.first;
+           scope;
+           scope = ZTAST_NODE(exec->ast, scope)->next)
       {
-      case ZTVAL_INTEGER:
-        index = assignmentexpr->data.value->data.integer;
-        if (index < 0 || index >= field->array->nelems)
-          return zt_mksyntax(errbuf, ztsyntx_VALUE_RANGE);
-
-        *prawvalue = (char *) field->array->base + index * elsz;
-        break;
-
-      case ZTVAL_NIL:
-        *prawvalue = NULL;
-        break;
+        rc = zt_run_statements(exec,
+                               insn->arg,
+                               ZTAST_NODE(exec->ast, scope)->expr.u.statements,
+                               rawstruct);
+        if (rc)
+          return rc;
 
-      default:
-        return zt_mksyntax(errbuf, ztsyntx_UNEXPECTED_VALUE_TYPE);
+        rawstruct += insn->elsz;
       }
     }
-    else /* expecting an array */
-    {
-      return zt_mksyntax(errbuf, ztsyntx_UNSUPPORTED);
-    }
     break;
 
-  case zttype_arrayidx:
+  case ztop_STATICINDEX:
+    return zt_do_index(expr,
+                       insn->ptr,
+                       insn->arg,
+                       insn->elsz,
+                       PVAL(structure, insn->offset),
+                       errbuf);
+
+  case ztop_REGIONINDEX:
     {
-      int              r;
       const ztarray_t *array;
-      size_t           elsz;
-
-      assert(field->array == ZT_NO_ARRAY);
-      assert(field->regionid);
 
-      for (r = 0; r < nregions; r++)
-        if (field->regionid == regions[r].id)
-          break;
-      if (r == nregions)
+      array = zt_exec_region(exec, insn->arg);
+      if (array == NULL)
         return zt_mksyntax(errbuf, ztsyntx_UNKNOWN_REGION);
-
-      array = &regions[r].spec;
-      elsz  = array->length / array->nelems;
-
-      if (field->nelems == 1) /* expecting a single element */
-      {
-        const ztast_expr_t *assignmentexpr;
-        void              **prawvalue;
-        int                 index;
-
-        assignmentexpr = assignment->expr;
-        if (assignmentexpr->type != ZTEXPR_VALUE)
-          return zt_mksyntax(errbuf, ztsyntx_NEED_VALUE);
-
-        prawvalue = PVAL(structure, field->offset);
-
-        switch (assignmentexpr->data.value->type)
-        {
-        case ZTVAL_INTEGER:
-          index = assignmentexpr->data.value->data.integer;
-          if (index < 0 || index >= array->nelems)
-            return zt_mksyntax(errbuf, ztsyntx_VALUE_RANGE);
-
-          *prawvalue = (char *) array->base + index * elsz;
-          break;
-
-        case ZTVAL_NIL:
-          *prawvalue = NULL;
-          break;
-
-        default:
-          return zt_mksyntax(errbuf, ztsyntx_UNEXPECTED_VALUE_TYPE);
-        }
-      }
-      else /* expecting an array */
-      {
+      if (insn->count != 1)
         return zt_mksyntax(errbuf, ztsyntx_UNSUPPORTED);
-      }
-      break;
+
+      return zt_do_index(expr,
+                         array->base,
+                         array->nelems,
+                         array->length / array->nelems,
+                         PVAL(structure, insn->offset),
+                         errbuf);
     }
 
-  case zttype_version:
-    if (field->nelems == 1) /* expecting a single element */
+  case ztop_VERSION:
     {
-      const ztast_expr_t *assignmentexpr;
-      int                 decimal;
-      int                *prawvalue;
+      int  decimal;
+      int *prawvalue;
 
-      assignmentexpr = assignment->expr;
-      if (assignmentexpr->type != ZTEXPR_VALUE)
+      if (expr->type != ZTEXPR_VALUE)
         return zt_mksyntax(errbuf, ztsyntx_NEED_VALUE);
-      if (assignmentexpr->data.value->type != ZTVAL_DECIMAL)
+      if (expr->valuetype != ZTVAL_DECIMAL)
         return zt_mksyntax(errbuf, ztsyntx_NEED_DECIMAL);
-      decimal = assignmentexpr->data.value->data.decimal;
+      decimal = expr->u.decimal;
       if (decimal < 0 || decimal > 999)
         return zt_mksyntax(errbuf, ztsyntx_VALUE_RANGE);
 
-      prawvalue = PVAL(structure, field->offset);
+      prawvalue = PVAL(structure, insn->offset);
       *prawvalue = decimal;
     }
-    else /* expecting an array */
-    {
-      return zt_mksyntax(errbuf, ztsyntx_UNSUPPORTED);
-    }
     break;
 
-  case zttype_custom:
-    if (field->nelems == 1) /* expecting a single element */
+  case ztop_CUSTOM:
     {
-      const ztast_expr_t *assignmentexpr;
-      void               *prawvalue;
+      ztresult_t    rc;
+      ztast_expr_t *view;
 
-      assignmentexpr = assignment->expr;
-      prawvalue      = PVAL(structure, field->offset);
-      return loaders[field->typeidx](assignmentexpr, prawvalue, errbuf);
-    }
-    else /* expecting an array */
-    {
-      return zt_mksyntax(errbuf, ztsyntx_UNSUPPORTED);
+      /* loaders take the public form of the expression */
+      view = ztast_view_expr(exec->ast, expr);
+      if (view == NULL)
+        return ztresult_OOM;
+
+      rc = exec->loaders[insn->arg](view,
+                                    PVAL(structure, insn->offset),
+                                    errbuf);
+
+      ztast_view_expr_destroy(view);
+
+      return rc;
     }
-    break;
+
+  default:
+    return zt_mksyntax(errbuf, ztsyntx_UNSUPPORTED);
   }
 
   return ztresult_OK;
@@ -512,52 +391,94 @@ static ztresult_t zt_do_assignment(const ztast_assignment_t *assignment,
 /**
  * Execute the given statements.
  *
- * \param statements AST
- * \param meta description of 'structure'
- * \param regions runtime heap array specs
- * \param nregions number of heap array specs
- * \param loaders array of loader functions - one per custom ID
- * \param nloaders number of loader functions
+ * \param exec execution state
+ * \param header index of the plan's header for 'structure'
+ * \param statements index of the first statement
  * \param structure structure to populate
- * \param syntax_error error message, or NULL if none
  */
-static ztresult_t zt_run_statements(const ztast_statement_t *statements,
-                                    const ztstruct_t        *meta,
-                                    const ztregion_t        *regions,
-                                    int                      nregions,
-                                    ztloader_t             **loaders,
-                                    int                      nloaders,
-                                    void                    *structure,
-                                    char                    *errbuf)
+static ztresult_t zt_run_statements(ztexec_t      *exec,
+                                    int            header,
+                                    ztast_index_t  statements,
+                                    void          *structure)
 {
-  ztresult_t               rc;
-  const ztast_statement_t *statement;
+  const ztstruct_t *meta;
+  ztast_index_t     statement;
+  int               lastfield;
 
-  for (statement = statements; statement; statement = statement->next)
+  meta      = ZTPLAN_META(exec->plan, header);
+  lastfield = -1;
+
+  /* every statement is an assignment */
+  for (statement = statements;
+       statement;
+       statement = ZTAST_NODE(exec->ast, statement)->next)
   {
-    switch (statement->type)
-    {
-    case ZTSTMT_ASSIGNMENT:
-      rc = zt_do_assignment(statement->u.assignment,
-                            meta,
-                            regions,
-                            nregions,
-                            loaders,
-                            nloaders,
-                            structure,
-                            errbuf);
-      if (rc)
-        return rc;
-      break;
+    const ztast_node_t *assignment;
+    const char         *name;
+    int                 f;
+    ztresult_t          rc;
+
+    assignment = ZTAST_NODE(exec->ast, statement);
+    name       = ZTAST_NAME(exec->ast, assignment);
+    logf(("assignment to field '%s'\n", name));
+
+    f = zt_exec_lookup(exec, meta, lastfield, name, strlen(name));
+    if (f < 0)
+      return zt_mksyntax(exec->errbuf, ztsyntx_UNKNOWN_FIELD);
+
+    lastfield = f;
+
+    rc = zt_do_insn(exec,
+                    ZTPLAN_FIELD(exec->plan, header, f),
+                   &assignment->expr,
+                    structure);
+    if (rc)
+      return rc;
+  }
 
-    default:
-      return zt_mksyntax(errbuf, ztsyntx_UNSUPPORTED);
-    }
+  return ztresult_OK;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static ztresult_t zt_exec_init(ztexec_t          *exec,
+                               const ztstruct_t  *meta,
+                               const ztregion_t  *regions,
+                               int                nregions,
+                               ztloader_t       **loaders,
+                               int                nloaders)
+{
+  exec->ast      = NULL;
+  exec->loaders  = loaders;
+  exec->nloaders = nloaders;
+  exec->errbuf   = NULL;
+  exec->resolved = NULL;
+
+  exec->stats.predicted = 0;
+  exec->stats.searched  = 0;
+
+  zt_regiontable_init(&exec->regions, regions, nregions);
+
+  exec->plan = zt_plan_get(meta);
+  if (exec->plan == NULL)
+    return ztresult_OOM;
+
+  if (exec->plan->nregionids > 0)
+  {
+    exec->resolved = calloc(exec->plan->nregionids, sizeof(*exec->resolved));
+    if (exec->resolved == NULL)
+      return ztresult_OOM;
   }
 
   return ztresult_OK;
 }
 
+static void zt_exec_fini(ztexec_t *exec)
+{
+  free(exec->resolved);
+  zt_regiontable_fini(&exec->regions);
+}
+
 ztresult_t zt_run_program(const ztast_t     *ast,
                           const ztstruct_t  *metastruct,
                           const ztregion_t  *regions,
@@ -565,19 +486,394 @@ ztresult_t zt_run_program(const ztast_t     *ast,
                           ztloader_t       **loaders,
                           int                nloaders,
                           void              *structure,
-                          char              *errbuf)
+                          char              *errbuf,
+                          ztloadstats_t     *stats)
 {
-  if (ast->program == NULL)
+  ztresult_t rc;
+  ztexec_t   exec;
+
+  if (!ast->haveprogram)
     return ztresult_NO_PROGRAM;
 
-  return zt_run_statements(ast->program->statements,
-                           metastruct,
-                           regions,
-                           nregions,
-                           loaders,
-                           nloaders,
-                           structure,
-                           errbuf);
+  rc = zt_exec_init(&exec, metastruct, regions, nregions, loaders, nloaders);
+  if (rc == ztresult_OK)
+  {
+    exec.ast    = ast;
+    exec.errbuf = errbuf;
+
+    rc = zt_run_statements(&exec, 0, ast->program, structure);
+  }
+
+  if (stats)
+    *stats = exec.stats;
+
+  zt_exec_fini(&exec);
+
+  return rc;
+}
+
+/* ----------------------------------------------------------------------- */
+
+/* Streaming loads
+ *
+ * The parser calls these from its reduce actions. An assignment's field is
+ * resolved when its name is reduced, which happens before any of its
+ * expression is, and a frame is pushed for it. Scopes and arrays announce
+ * their openings so that the expression's type can be checked before any
+ * of its contents are stored. */
+
+/** Returns non-zero once the load has failed, noting any allocation
+ * failure. */
+static int zt_stream_failed(ztstream_t *stream)
+{
+  if (stream->rc == ztresult_OK && stream->ast->oom)
+    stream->rc = ztresult_OOM;
+  return stream->rc != ztresult_OK || stream->exec.errbuf[0] != '\0';
+}
+
+static void zt_stream_fail(ztstream_t *stream, ztsyntaxerr_t e)
+{
+  stream->rc = zt_mksyntax(stream->exec.errbuf, e);
+}
+
+/** Check that an expression of 'type' can be assigned to the field for
+ * 'insn', giving the same errors that zt_do_insn would. */
+static ztresult_t zt_check_expr(ztexec_t       *exec,
+                                const ztinsn_t *insn,
+                                int             type)
+{
+  char *errbuf = exec->errbuf;
+
+  switch (insn->op)
+  {
+  case ztop_UCHAR:
+  case ztop_USHORT:
+  case ztop_UINT:
+    if (type != ZTEXPR_VALUE)
+      return zt_mksyntax(errbuf, ztsyntx_NEED_VALUE);
+    break;
+
+  case ztop_UCHARS:
+  case ztop_USHORTS:
+  case ztop_UINTS:
+    if (type != ZTEXPR_INTARRAY)
+      return zt_mksyntax(errbuf, ztsyntx_NEED_INTEGERARRAY);
+    break;
+
+  case ztop_STRUCT:
+    if (type != ZTEXPR_SCOPE)
+      return zt_mksyntax(errbuf, ztsyntx_NEED_SCOPE);
+    break;
+
+  case ztop_STRUCTS:
+    if (type != ZTEXPR_SCOPEARRAY)
+      return zt_mksyntax(errbuf, ztsyntx_NEED_SCOPEARRAY);
+    break;
+
+  case ztop_REGIONINDEX:
+    if (zt_exec_region(exec, insn->arg) == NULL)
+      return zt_mksyntax(errbuf, ztsyntx_UNKNOWN_REGION);
+    if (insn->count != 1)
+      return zt_mksyntax(errbuf, ztsyntx_UNSUPPORTED);
+    /* FALLTHROUGH */
+
+  case ztop_STATICINDEX:
+  case ztop_VERSION:
+    if (type != ZTEXPR_VALUE)
+      return zt_mksyntax(errbuf, ztsyntx_NEED_VALUE);
+    break;
+
+  case ztop_CUSTOM:
+    break;
+
+  default:
+    return zt_mksyntax(errbuf, ztsyntx_UNSUPPORTED);
+  }
+
+  return ztresult_OK;
+}
+
+/** Check the type of the top frame's expression, once. */
+static int zt_stream_check(ztstream_t *stream, int type)
+{
+  ztstreamframe_t *frame = &stream->frames[stream->depth - 1];
+
+  if (frame->checked)
+    return 1;
+
+  stream->rc = zt_check_expr(&stream->exec, frame->insn, type);
+  frame->checked = 1;
+  return stream->rc == ztresult_OK;
+}
+
+ztresult_t zt_stream_init(ztstream_t        *stream,
+                          const ztstruct_t  *meta,
+                          void              *structure,
+                          const ztregion_t  *regions,
+                          int                nregions,
+                          ztloader_t       **loaders,
+                          int                nloaders)
+{
+  stream->ast       = NULL;
+  stream->structure = structure;
+  stream->rc        = ztresult_OK;
+  stream->building  = 0;
+  stream->lastfield = -1;
+  stream->depth     = 0;
+
+  stream->framesallocated = 0;
+  stream->frames          = NULL;
+
+  return zt_exec_init(&stream->exec,
+                       meta,
+                       regions,
+                       nregions,
+                       loaders,
+                       nloaders);
+}
+
+void zt_stream_fini(ztstream_t *stream)
+{
+  free(stream->frames);
+  zt_exec_fini(&stream->exec);
+}
+
+/* Double the size of the frame stack (or create it). */
+static int zt_stream_grow(ztstream_t *stream)
+{
+  int              newallocated;
+  ztstreamframe_t *newframes;
+
+  newallocated = stream->framesallocated ? stream->framesallocated * 2
+                                         : ZTSTREAM_MINFRAMES;
+  newframes = realloc(stream->frames, newallocated * sizeof(*newframes));
+  if (newframes == NULL)
+  {
+    stream->rc = ztresult_OOM;
+    return 0;
+  }
+
+  stream->frames          = newframes;
+  stream->framesallocated = newallocated;
+
+  return 1;
+}
+
+unsigned int zt_stream_field(ztstream_t *stream,
+                             const char *name,
+                             size_t      length)
+{
+  const ztplan_t   *plan = stream->exec.plan;
+  int               header;
+  void             *structure;
+  int              *lastfield;
+  int               f;
+  const ztinsn_t   *insn;
+  ztstreamframe_t  *frame;
+
+  if (stream->building)
+    return ztast_id(stream->ast, name, length);
+
+  if (zt_stream_failed(stream))
+    return 0;
+
+  /* the scope is the innermost struct being filled, if any */
+  if (stream->depth == 0)
+  {
+    header    = 0;
+    structure = stream->structure;
+    lastfield = &stream->lastfield;
+  }
+  else
+  {
+    frame     = &stream->frames[stream->depth - 1];
+    header    = frame->insn->arg;
+    structure = (char *) frame->elements + frame->index * frame->insn->elsz;
+    lastfield = &frame->lastfield;
+  }
+
+  logf(("assignment to field '%.*s'\n", (int) length, name));
+  f = zt_exec_lookup(&stream->exec,
+                     ZTPLAN_META(plan, header), *lastfield, name, length);
+  if (f < 0)
+  {
+    zt_stream_fail(stream, ztsyntx_UNKNOWN_FIELD);
+    return 0;
+  }
+
+  *lastfield = f;
+
+  if (stream->depth == stream->framesallocated && !zt_stream_grow(stream))
+    return 0;
+
+  insn = ZTPLAN_FIELD(plan, header, f);
+  assert(insn->count >= 1);
+
+  frame = &stream->frames[stream->depth++];
+  frame->insn      = insn;
+  frame->structure = structure;
+  frame->elements  = zt_insn_storage(insn, structure);
+  frame->index     = 0;
+  frame->inarray   = 0;
+  frame->checked   = 0;
+
+  if (insn->op == ztop_CUSTOM)
+  {
+    /* custom loaders take an AST of the expression, so build one */
+    frame->nodesmark = stream->ast->nnodes;
+    frame->intsmark  = stream->ast->nints;
+    stream->building = 1;
+  }
+
+  return 0;
+}
+
+ztast_index_t zt_stream_assignment(ztstream_t             *stream,
+                                   unsigned int            name,
+                                   const ztast_exprnode_t *expr)
+{
+  ztstreamframe_t *frame;
+
+  /* an assignment within a custom loader's expression */
+  if (stream->building > 1)
+    return ztast_assignment(stream->ast, name, expr);
+
+  if (zt_stream_failed(stream))
+    return 0;
+
+  frame = &stream->frames[stream->depth - 1];
+
+  if (stream->building)
+  {
+    stream->rc = zt_do_insn(&stream->exec,
+                             frame->insn,
+                             expr,
+                             frame->structure);
+
+    /* discard the expression's AST */
+    stream->ast->nnodes = frame->nodesmark;
+    stream->ast->nints  = frame->intsmark;
+    stream->building    = 0;
+  }
+  else if (expr->type == ZTEXPR_VALUE)
+  {
+    stream->rc = zt_do_insn(&stream->exec,
+                             frame->insn,
+                             expr,
+                             frame->structure);
+  }
+  else
+  {
+    /* arrays and scopes were stored as they arrived, though an empty array
+     * has yet to be checked */
+    (void) zt_stream_check(stream, expr->type);
+  }
+
+  stream->depth--;
+
+  return 0;
+}
+
+void zt_stream_scope_open(ztstream_t *stream)
+{
+  ztstreamframe_t *frame;
+
+  if (stream->building)
+  {
+    stream->building++;
+    return;
+  }
+
+  if (zt_stream_failed(stream))
+    return;
+
+  frame = &stream->frames[stream->depth - 1];
+  if (!zt_stream_check(stream, frame->inarray ? ZTEXPR_SCOPEARRAY
+                                              : ZTEXPR_SCOPE))
+    return;
+
+  if (frame->index >= frame->insn->count)
+    zt_stream_fail(stream, ztsyntx_VALUE_RANGE);
+
+  /* each element starts over from its first field */
+  frame->lastfield = -1;
+}
+
+void zt_stream_scope_close(ztstream_t *stream)
+{
+  if (stream->building)
+  {
+    stream->building--;
+    return;
+  }
+
+  if (zt_stream_failed(stream))
+    return;
+
+  /* on to the next element of a scope array */
+  stream->frames[stream->depth - 1].index++;
+}
+
+void zt_stream_array_open(ztstream_t *stream)
+{
+  if (stream->building || zt_stream_failed(stream))
+    return;
+
+  stream->frames[stream->depth - 1].inarray = 1;
+}
+
+ztast_intslice_t zt_stream_ints(ztstream_t             *stream,
+                                const ztast_intslice_t *inner,
+                                const unsigned int     *values,
+                                int                     nvalues)
+{
+  ztast_intslice_t  none = { 0, 0 };
+  ztstreamframe_t  *frame;
+  int               n;
+
+  if (stream->building)
+    return ztast_intarrayinner_append_run(stream->ast, inner, values, nvalues);
+
+  if (zt_stream_failed(stream))
+    return none;
+
+  if (!zt_stream_check(stream, ZTEXPR_INTARRAY))
+    return none;
+
+  frame = &stream->frames[stream->depth - 1];
+
+  /* store as many as fit */
+  n = frame->insn->count - frame->index;
+  if (n > nvalues)
+    n = nvalues;
+
+  stream->rc = zt_store_ints(frame->insn,
+                             frame->elements,
+                             frame->index,
+                             values,
+                             n,
+                             stream->exec.errbuf);
+  if (stream->rc)
+    return none;
+
+  frame->index += n;
+  if (n < nvalues)
+    zt_stream_fail(stream, ztsyntx_VALUE_RANGE);
+
+  return none;
+}
+
+ztast_list_t zt_stream_scopes(ztstream_t         *stream,
+                              const ztast_list_t *inner,
+                              ztast_index_t       statements)
+{
+  ztast_list_t none = { 0, 0, 0 };
+
+  if (stream->building)
+    return ztast_scopearrayinner_append(stream->ast, inner, statements);
+
+  /* the scopes' contents have already been stored */
+  return none;
 }
 
 /* ----------------------------------------------------------------------- */
@@ -6,6 +6,8 @@
 #include "zerotape/zerotape.h"
 
 #include "zt-ast.h"
+#include "zt-plan.h"
+#include "zt-region.h"
 
 /**
  * Execute the given program.
@@ -18,6 +20,7 @@
  * \param nloaders number of loader functions
  * \param structure structure to populate
  * \param errbuf buffer for error message(s)
+ * \param stats updated with the load's counts, if not NULL
  */
 ztresult_t zt_run_program(const ztast_t    *ast,
                           const ztstruct_t *meta,
@@ -26,7 +29,104 @@ ztresult_t zt_run_program(const ztast_t    *ast,
                           ztloader_t      **loaders,
                           int               nloaders,
                           void             *structure,
-                          char             *errbuf);
+                          char             *errbuf,
+                          ztloadstats_t    *stats);
+
+/* ----------------------------------------------------------------------- */
+
+/* Streaming loads.
+ *
+ * Instead of building an AST and running it afterwards, a streaming load
+ * has the parser's reduce actions resolve each assignment against the
+ * current scope and store values straight into the structure, so memory
+ * use is proportional to the nesting depth rather than to the input. Only
+ * the expressions given to custom loaders are built as ASTs, and those are
+ * discarded once used. */
+
+/* Execution state shared by AST and streaming loads. */
+typedef struct ztexec
+{
+  const ztast_t     *ast;
+  const ztplan_t    *plan;
+  ztregiontable_t    regions;
+  const ztarray_t  **resolved; /* each region slot's array, once found */
+  ztloader_t       **loaders;
+  int                nloaders;
+  char              *errbuf;
+  ztloadstats_t      stats;
+}
+ztexec_t;
+
+/* Initial number of stream frames. The stack doubles when full. */
+#define ZTSTREAM_MINFRAMES (8)
+
+/* An assignment in progress. */
+typedef struct ztstreamframe
+{
+  const ztinsn_t  *insn;      /* instruction for the field being assigned */
+  void            *structure; /* structure containing the field */
+  void            *elements;  /* storage for the field */
+  int              index;     /* next array element to fill */
+  int              inarray;   /* the expression is an array */
+  int              checked;   /* the expression's type has been checked */
+  int              lastfield; /* struct fields: last field assigned within
+                                 the current element, or -1 */
+  ztast_index_t    nodesmark; /* custom fields: extent of the AST before */
+  unsigned int     intsmark;
+}
+ztstreamframe_t;
+
+typedef struct ztstream
+{
+  ztast_t           *ast;  /* parser's AST, set by the driver along with
+                               exec.ast and exec.errbuf */
+  ztexec_t           exec;
+
+  void              *structure;
+
+  ztresult_t         rc;
+
+  int                building; /* one plus the scopes open, while building a
+                                  custom loader's expression */
+
+  int                lastfield; /* last top level field assigned, or -1 */
+
+  int                depth;
+  int                framesallocated;
+  ztstreamframe_t   *frames; /* one per assignment open */
+}
+ztstream_t;
+
+ztresult_t zt_stream_init(ztstream_t        *stream,
+                          const ztstruct_t  *meta,
+                          void              *structure,
+                          const ztregion_t  *regions,
+                          int                nregions,
+                          ztloader_t       **loaders,
+                          int                nloaders);
+
+void zt_stream_fini(ztstream_t *stream);
+
+/* Parser actions. These fall back to building the AST while inside the
+ * expression of a custom field. */
+unsigned int zt_stream_field(ztstream_t *stream,
+                             const char *name,
+                             size_t      length);
+ztast_index_t zt_stream_assignment(ztstream_t             *stream,
+                                   unsigned int            name,
+                                   const ztast_exprnode_t *expr);
+void zt_stream_scope_open(ztstream_t *stream);
+void zt_stream_scope_close(ztstream_t *stream);
+void zt_stream_array_open(ztstream_t *stream);
+ztast_intslice_t zt_stream_ints(ztstream_t             *stream,
+                                const ztast_intslice_t *inner,
+                                const unsigned int     *values,
+                                int                     nvalues);
+ztast_list_t zt_stream_scopes(ztstream_t         *stream,
+                              const ztast_list_t *inner,
+                              ztast_index_t       statements);
+
+/* ----------------------------------------------------------------------- */
 
 #endif /* ZT_RUN_H */
 
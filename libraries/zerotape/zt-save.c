@@ -2,7 +2,6 @@
 
 #include <assert.h>
 #include <limits.h>
-#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -13,12 +12,8 @@
 
 /* ----------------------------------------------------------------------- */
 
-/* printf formatting token for outputting integers. */
-#ifdef ZT_USE_HEX
-#define FMT "$%X" /* hex */
-#else
-#define FMT "%u"
-#endif
+/* Size of the output buffer. */
+#define SAVE_BUFSZ (64 * 1024)
 
 /* ----------------------------------------------------------------------- */
 
@@ -113,8 +108,15 @@ static void savestack_destroy(save_stack_t *stack)
 
 typedef struct savestate
 {
-  FILE              *f;
-  int                indent_is_due;
+  ztsink_t          *sink;
+  void              *sinkarg;
+  ztresult_t         rc;          /* first error returned by 'sink' */
+  char              *buf;         /* output buffer, SAVE_BUFSZ bytes, or NULL
+                                     if only measuring */
+  size_t             used;        /* bytes of 'buf' used */
+  size_t             measured;    /* bytes output when measuring */
+  int                linestart;   /* nothing has been output on this line */
+  ztsaveflags_t      flags;       /* ztsaveflag_* options */
   int                depth;
   save_stack_t       stack;
   ztsaver_t        **savers;
@@ -132,38 +134,159 @@ static void outdent(savestate_t *state)
   state->depth--;
 }
 
-static void emitf(savestate_t *state, const char *fmt, ...)
+/* ----------------------------------------------------------------------- */
+
+/* Output goes into a buffer which is passed to the sink when full. Once the
+ * sink fails all further output is discarded. */
+
+static void sink(savestate_t *state, const char *s, size_t n)
 {
-  va_list ap;
-  size_t  fmtlen;
+  if (state->rc)
+    return;
+
+#ifdef ZT_DEBUG
+  fwrite(s, 1, n, stdout);
+#endif
+
+  state->rc = state->sink(s, n, state->sinkarg);
+}
 
-  if (state->indent_is_due)
+static void flush(savestate_t *state)
+{
+  if (state->used == 0)
+    return;
+
+  sink(state, state->buf, state->used);
+  state->used = 0;
+}
+
+static void emit_raw(savestate_t *state, const char *s, size_t n)
+{
+  if (state->buf == NULL)
   {
-    int depth;
-    int i;
+    state->measured += n;
+    return;
+  }
 
-    depth = state->depth;
-    for (i = 0; i < depth; i++)
+  if (state->used + n > SAVE_BUFSZ)
+  {
+    flush(state);
+    if (n > SAVE_BUFSZ)
     {
-#ifdef ZT_DEBUG
-      printf("  ");
-#endif
-      fprintf(state->f, "  ");
+      sink(state, s, n);
+      return;
     }
   }
 
-#ifdef ZT_DEBUG
-  va_start(ap, fmt);
-  vprintf(fmt, ap);
-  va_end(ap);
+  memcpy(state->buf + state->used, s, n);
+  state->used += n;
+}
+
+/* Output the indentation, if at the start of a line. */
+static void emit_indent(savestate_t *state)
+{
+  static const char spaces[] = "                                "
+                               "                                ";
+  size_t width;
+
+  if (!state->linestart)
+    return;
+
+  state->linestart = 0;
+  for (width = state->depth * 2; width > 0; )
+  {
+    size_t chunk = width < sizeof(spaces) - 1 ? width : sizeof(spaces) - 1;
+    emit_raw(state, spaces, chunk);
+    width -= chunk;
+  }
+}
+
+/* Output 'n' bytes, indenting them if they start a line. */
+static void emit(savestate_t *state, const char *s, size_t n)
+{
+  emit_indent(state);
+  emit_raw(state, s, n);
+}
+
+static void emit_str(savestate_t *state, const char *s)
+{
+  emit(state, s, strlen(s));
+}
+
+static void emit_newline(savestate_t *state)
+{
+  if (state->flags & ztsaveflag_COMPACT)
+    return;
+
+  emit_raw(state, "\n", 1);
+  state->linestart = 1;
+}
+
+/* Output an unsigned integer in decimal. */
+static void emit_decimal(savestate_t *state, unsigned long value)
+{
+  char  buf[24];
+  char *p = buf + sizeof(buf);
+
+  if (state->buf == NULL)
+  {
+    emit_indent(state);
+    do
+      state->measured++;
+    while ((value /= 10) != 0);
+    return;
+  }
+
+  do
+    *--p = (char) ('0' + value % 10);
+  while ((value /= 10) != 0);
+
+  emit(state, p, buf + sizeof(buf) - p);
+}
+
+/* Output an integer value in the style chosen by ZT_USE_HEX. */
+static void emit_value(savestate_t *state, unsigned int value)
+{
+#ifdef ZT_USE_HEX
+  static const char digits[] = "0123456789ABCDEF";
+  char              buf[sizeof(value) * 2 + 1];
+  char             *p = buf + sizeof(buf);
+
+  if (state->buf == NULL)
+  {
+    emit_indent(state);
+    state->measured++; /* '$' */
+    do
+      state->measured++;
+    while ((value >>= 4) != 0);
+    return;
+  }
+
+  do
+    *--p = digits[value & 15];
+  while ((value >>= 4) != 0);
+  *--p = '$';
+
+  emit(state, p, buf + sizeof(buf) - p);
+#else
+  emit_decimal(state, value);
 #endif
+}
 
-  va_start(ap, fmt);
-  vfprintf(state->f, fmt, ap);
-  va_end(ap);
+/* Output "<name> = ". */
+static void emit_name(savestate_t *state, const char *name)
+{
+  emit_str(state, name);
+  if (state->flags & ztsaveflag_COMPACT)
+    emit_raw(state, "=", 1);
+  else
+    emit_raw(state, " = ", 3);
+}
 
-  fmtlen = strlen(fmt);
-  state->indent_is_due = (fmt[fmtlen - 1] == '\n'); /* weak newline detection */
+/* Output the separator between array elements. */
+static void emit_comma(savestate_t *state)
+{
+  emit_raw(state, ", ", (state->flags & ztsaveflag_COMPACT) ? 1 : 2);
 }
 
 /* ----------------------------------------------------------------------- */
@@ -171,18 +294,27 @@ static void emitf(savestate_t *state, const char *fmt, ...)
 #define DUMP(TYPE)                                                     \
   do {                                                                 \
     if (nelems == 1) { /* singletons are rendered as: x = $0; */       \
-      emitf(state, "%s = " FMT ";\n", name, *pvalue);                  \
+      emit_name(state, name);                                          \
+      emit_value(state, *pvalue);                                      \
+      emit_raw(state, ";", 1);                                         \
+      emit_newline(state);                                             \
     } else { /* arrays are rendered as: x = [ $0, $1, $2, ...]; */     \
       size_t j,k;                                                      \
-      emitf(state, "%s = [\n", name);                                  \
+      emit_name(state, name);                                          \
+      emit_raw(state, "[", 1);                                         \
+      emit_newline(state);                                             \
       indent(state);                                                   \
       for (j = 0; j < nelems; j += stride) {                           \
-        for (k = j; k < j + stride; k++)                               \
-          emitf(state, (k <  nelems - 1) ? FMT ", " : FMT, *pvalue++); \
-        emitf(state, "\n");                                            \
+        for (k = j; k < j + stride && k < nelems; k++) {               \
+          emit_value(state, *pvalue++);                                \
+          if (k < nelems - 1)                                          \
+            emit_comma(state);                                         \
+        }                                                              \
+        emit_newline(state);                                           \
       }                                                                \
       outdent(state);                                                  \
-      emitf(state, "];\n");                                            \
+      emit(state, "];", 2);                                            \
+      emit_newline(state);                                             \
     }                                                                  \
   } while (0)
 
@@ -196,7 +328,7 @@ static ztresult_t savehandler_uchar(const char      *name,
 {
   savestate_t *state = opaque;
   DUMP(byte_t);
-  return ztresult_OK;
+  return state->rc;
 }
 
 static ztresult_t savehandler_ushort(const char       *name,
@@ -207,7 +339,7 @@ static ztresult_t savehandler_ushort(const char       *name,
 {
   savestate_t *state = opaque;
   DUMP(half_t);
-  return ztresult_OK;
+  return state->rc;
 }
 
 static ztresult_t savehandler_uint(const char     *name,
@@ -218,7 +350,7 @@ static ztresult_t savehandler_uint(const char     *name,
 {
   savestate_t *state = opaque;
   DUMP(word_t);
-  return ztresult_OK;
+  return state->rc;
 }
 
 static ztresult_t savehandler_index(const char *name,
@@ -226,20 +358,45 @@ static ztresult_t savehandler_index(const char *name,
                                     void       *opaque)
 {
   savestate_t *state = opaque;
+  emit_name(state, name);
   if (index == ULONG_MAX)
-    emitf(state, "%s = nil;\n", name);
+    emit_raw(state, "nil", 3);
   else
-    emitf(state, "%s = %d;\n", name, index);
-  return ztresult_OK;
+    emit_decimal(state, index);
+  emit_raw(state, ";", 1);
+  emit_newline(state);
+  return state->rc;
 }
 
 static ztresult_t savehandler_version(const char *name,
                                       ztversion_t version,
                                       void       *opaque)
 {
-  savestate_t *state = opaque;
-  emitf(state, "%s = %.2f;\n", name, (double) version / 100.0);
-  return ztresult_OK;
+  savestate_t  *state = opaque;
+  unsigned int  hundredths;
+  char          fraction[3];
+
+  emit_name(state, name);
+
+  /* rendered as a decimal with two places, e.g. 1.05 */
+  if (version < 0)
+  {
+    emit_raw(state, "-", 1);
+    hundredths = 0U - (unsigned int) version;
+  }
+  else
+  {
+    hundredths = version;
+  }
+  emit_decimal(state, hundredths / 100);
+  fraction[0] = '.';
+  fraction[1] = (char) ('0' + hundredths / 10 % 10);
+  fraction[2] = (char) ('0' + hundredths % 10);
+  emit_raw(state, fraction, 3);
+
+  emit_raw(state, ";", 1);
+  emit_newline(state);
+  return state->rc;
 }
 
 static ztresult_t savehandler_startstruct(const char *name, void *opaque)
@@ -266,16 +423,17 @@ static ztresult_t savehandler_startstruct(const char *name, void *opaque)
   if (isarray)
   {
     scope->index++;
-    emitf(state, "{\n");
   }
   else
   {
-    emitf(state, "%s = {\n", name);
+    emit_name(state, name);
   }
+  emit(state, "{", 1);
+  emit_newline(state);
 
   indent(state);
 
-  return ztresult_OK;
+  return state->rc;
 }
 
 static ztresult_t savehandler_endstruct(void *opaque)
@@ -298,17 +456,18 @@ static ztresult_t savehandler_endstruct(void *opaque)
   if (isarray)
   {
     if (scope->index < scope->nelems)
-      end = "},\n";
+      end = "},";
     else
-      end = "}\n";
+      end = "}";
   }
   else
   {
-    end = "};\n";
+    end = "};";
   }
-  emitf(state, end);
+  emit_str(state, end);
+  emit_newline(state);
 
-  return ztresult_OK;
+  return state->rc;
 }
 
 static ztresult_t savehandler_startarray(const char *name,
@@ -326,10 +485,12 @@ static ztresult_t savehandler_startarray(const char *name,
   if (rc)
     return rc;
 
-  emitf(state, "%s = [\n", name);
+  emit_name(state, name);
+  emit_raw(state, "[", 1);
+  emit_newline(state);
   indent(state);
 
-  return ztresult_OK;
+  return state->rc;
 }
 
 static ztresult_t savehandler_endarray(void *opaque)
@@ -337,11 +498,12 @@ static ztresult_t savehandler_endarray(void *opaque)
   savestate_t *state = opaque;
 
   outdent(state);
-  emitf(state, "];\n");
+  emit(state, "];", 2);
+  emit_newline(state);
 
   savestack_pop(&state->stack);
 
-  return ztresult_OK;
+  return state->rc;
 }
 
 static ztresult_t savehandler_custom(const char *name,
@@ -362,13 +524,174 @@ static ztresult_t savehandler_custom(const char *name,
   if (rc)
     return rc;
 
-  emitf(state, "%s = %s;\n", name, buf);
+  emit_name(state, name);
+  emit_str(state, buf);
+  emit_raw(state, ";", 1);
+  emit_newline(state);
+
+  return state->rc;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static const ztwalkhandlers_t savehandlers =
+{
+  savehandler_uchar,
+  savehandler_ushort,
+  savehandler_uint,
+  savehandler_index,
+  savehandler_version,
+  savehandler_startstruct,
+  savehandler_endstruct,
+  savehandler_startarray,
+  savehandler_endarray,
+  savehandler_custom
+};
+
+/* Walk 'structure' with the output set up in 'state'. */
+static ztresult_t save(savestate_t       *state,
+                       const ztstruct_t  *metastruct,
+                       const void        *structure,
+                       const ztregion_t  *regions,
+                       int                nregions,
+                       ztsaver_t        **savers,
+                       int                nsavers,
+                       ztsaveflags_t      flags)
+{
+  ztresult_t rc;
+
+  assert(metastruct);
+  assert(structure);
+  /* regions may be NULL */
+  assert(nregions >= 0);
+  /* savers may be NULL */
+  assert(nsavers >= 0);
+
+  state->rc        = ztresult_OK;
+  state->used      = 0;
+  state->measured  = 0;
+  state->linestart = 1;
+  state->flags     = flags;
+  state->depth     = 0;
+  savestack_setup(&state->stack);
+  state->savers    = savers;
+  state->nsavers   = nsavers;
+
+  rc = zt_walk(metastruct, structure, regions, nregions, &savehandlers, state);
+  if (rc == ztresult_OK)
+  {
+    flush(state);
+    rc = state->rc;
+  }
+
+  savestack_destroy(&state->stack);
+
+  return rc;
+}
+
+ztresult_t zt_save_to_sink(const ztstruct_t  *metastruct,
+                           const void        *structure,
+                           ztsink_t          *sinkfn,
+                           void              *opaque,
+                           const ztregion_t  *regions,
+                           int                nregions,
+                           ztsaver_t        **savers,
+                           int                nsavers,
+                           ztsaveflags_t      flags)
+{
+  ztresult_t  rc;
+  savestate_t state;
+
+  assert(sinkfn);
+
+  state.buf = malloc(SAVE_BUFSZ);
+  if (state.buf == NULL)
+    return ztresult_OOM;
+
+  state.sink    = sinkfn;
+  state.sinkarg = opaque;
+
+  rc = save(&state,
+            metastruct, structure, regions, nregions, savers, nsavers, flags);
+
+  free(state.buf);
+
+  return rc;
+}
+
+ztresult_t zt_save_measure(const ztstruct_t  *metastruct,
+                           const void        *structure,
+                           size_t            *plength,
+                           const ztregion_t  *regions,
+                           int                nregions,
+                           ztsaver_t        **savers,
+                           int                nsavers,
+                           ztsaveflags_t      flags)
+{
+  ztresult_t  rc;
+  savestate_t state;
+
+  assert(plength);
+
+  *plength = 0;
+
+  state.buf     = NULL; /* measure only */
+  state.sink    = NULL;
+  state.sinkarg = NULL;
+
+  rc = save(&state,
+            metastruct, structure, regions, nregions, savers, nsavers, flags);
+  if (rc)
+    return rc;
+
+  *plength = state.measured;
 
   return ztresult_OK;
 }
 
 /* ----------------------------------------------------------------------- */
 
+static ztresult_t filesink(const void *bytes, size_t n, void *opaque)
+{
+  FILE *f = opaque;
+
+  return (fwrite(bytes, 1, n, f) == n) ? ztresult_OK : ztresult_BAD_WRITE;
+}
+
+ztresult_t zt_save_to_file(const ztstruct_t  *metastruct,
+                           const void        *structure,
+                           const char        *filename,
+                           const ztregion_t  *regions,
+                           int                nregions,
+                           ztsaver_t        **savers,
+                           int                nsavers,
+                           ztsaveflags_t      flags)
+{
+  ztresult_t  rc;
+  FILE       *f;
+
+  assert(filename);
+
+  f = fopen(filename, "wb");
+  if (f == NULL)
+    return ztresult_BAD_FOPEN;
+
+  rc = zt_save_to_sink(metastruct,
+                       structure,
+                       filesink,
+                       f,
+                       regions,
+                       nregions,
+                       savers,
+                       nsavers,
+                       flags);
+
+  if (fclose(f) != 0 && rc == ztresult_OK)
+    rc = ztresult_BAD_WRITE;
+
+  return rc;
+}
+
 ztresult_t zt_save(const ztstruct_t  *metastruct,
                    const void        *structure,
                    const char        *filename,
@@ -377,56 +700,106 @@ ztresult_t zt_save(const ztstruct_t  *metastruct,
                    ztsaver_t        **savers,
                    int                nsavers)
 {
-  static const ztwalkhandlers_t savehandlers =
+  return zt_save_to_file(metastruct,
+                         structure,
+                         filename,
+                         regions,
+                         nregions,
+                         savers,
+                         nsavers,
+                         0);
+}
+
+/* ----------------------------------------------------------------------- */
+
+typedef struct buffersink
+{
+  char   *buf;
+  size_t  used;
+  size_t  allocated;
+}
+buffersink_t;
+
+static ztresult_t buffersink(const void *bytes, size_t n, void *opaque)
+{
+  buffersink_t *b = opaque;
+
+  /* keep room for a terminator */
+  if (b->used + n + 1 > b->allocated)
   {
-    savehandler_uchar,
-    savehandler_ushort,
-    savehandler_uint,
-    savehandler_index,
-    savehandler_version,
-    savehandler_startstruct,
-    savehandler_endstruct,
-    savehandler_startarray,
-    savehandler_endarray,
-    savehandler_custom
-  };
+    size_t  newallocated;
+    char   *newbuf;
 
-  ztresult_t  rc;
-  savestate_t state;
+    newallocated = b->allocated * 2; /* doubling strategy */
+    if (newallocated < SAVE_BUFSZ)
+      newallocated = SAVE_BUFSZ;
+    while (newallocated < b->used + n + 1)
+      newallocated *= 2;
 
-  assert(metastruct);
-  assert(structure);
-  assert(filename);
-  /* regions may be NULL */
-  assert(nregions >= 0);
-  /* savers may be NULL */
-  assert(nsavers >= 0);
+    newbuf = realloc(b->buf, newallocated);
+    if (newbuf == NULL)
+      return ztresult_OOM;
 
-  state.f = fopen(filename, "wb");
-  if (state.f == NULL)
-    return ztresult_BAD_FOPEN;
-  
-  state.indent_is_due = 0;
-  state.depth         = 0;
-  savestack_setup(&state.stack);
-  state.savers        = savers;
-  state.nsavers       = nsavers;
-
-  rc = zt_walk(metastruct, structure, regions, nregions, &savehandlers, &state);
-  if (rc)
-    goto err;
+    b->buf       = newbuf;
+    b->allocated = newallocated;
+  }
 
-  savestack_destroy(&state.stack);
-  fclose(state.f);
+  memcpy(b->buf + b->used, bytes, n);
+  b->used += n;
 
   return ztresult_OK;
+}
 
+ztresult_t zt_save_to_buffer(const ztstruct_t  *metastruct,
+                             const void        *structure,
+                             char             **pbuffer,
+                             size_t            *plength,
+                             const ztregion_t  *regions,
+                             int                nregions,
+                             ztsaver_t        **savers,
+                             int                nsavers,
+                             ztsaveflags_t      flags)
+{
+  ztresult_t   rc;
+  buffersink_t b;
+
+  assert(pbuffer);
+  assert(plength);
+
+  *pbuffer = NULL;
+  *plength = 0;
+
+  b.buf       = NULL;
+  b.used      = 0;
+  b.allocated = 0;
+
+  rc = zt_save_to_sink(metastruct,
+                       structure,
+                       buffersink,
+                       &b,
+                       regions,
+                       nregions,
+                       savers,
+                       nsavers,
+                       flags);
+  if (rc == ztresult_OK && b.buf == NULL) /* nothing was written */
+  {
+    b.buf = malloc(1);
+    if (b.buf == NULL)
+      rc = ztresult_OOM;
+  }
+  if (rc)
+  {
+    free(b.buf);
+    return rc;
+  }
 
-err:
-  savestack_destroy(&state.stack);
-  fclose(state.f);
+  b.buf[b.used] = '\0';
 
-  return rc;
+  *pbuffer = b.buf;
+  *plength = b.used;
+
+  return ztresult_OK;
 }
 
 /* ----------------------------------------------------------------------- */
@@ -12,7 +12,8 @@
 
 /* ----------------------------------------------------------------------- */
 
-#define SLAB_SIZE  (4000)
+/* Slabs double in size as they're added, up to this limit. */
+#define SLAB_MAXSIZE  (256 * 1024)
 
 #if defined(__LP64__) || defined(_WIN64)
 #define SLAB_ALIGN    (8)
@@ -20,24 +21,59 @@
 #define SLAB_ALIGN    (4)
 #endif
 
+/* Every block is preceded by a header holding its (rounded) size. This is
+ * one alignment unit so that blocks stay aligned. Sizes are multiples of
+ * SLAB_ALIGN so the bottom bit is free to mark large blocks. */
+#define SLAB_HEADER   (SLAB_ALIGN)
+#define SLAB_LARGE    (1)
+
+#define SLAB_HEADEROF(P) (((size_t *) (P))[-1])
+#define SLAB_SIZEOF(P)   (SLAB_HEADEROF(P) & ~(size_t) SLAB_LARGE)
+#define SLAB_ISLARGE(P)  (SLAB_HEADEROF(P) & SLAB_LARGE)
+
+/* Freed blocks of up to SLAB_NCLASSES * SLAB_ALIGN bytes are kept on one
+ * free list per size. Larger ones share a single list. */
+#define SLAB_NCLASSES (32)
+
 /* ----------------------------------------------------------------------- */
 
-struct ztslaballoc
+/* Blocks too big to share a slab come directly from malloc(). They're
+ * listed so that they can be released when the allocator is destroyed. */
+typedef struct ztslablarge
 {
-  void   **slablist;
-  size_t   nslablistused;
-  size_t   nslablistalloced;
-
-  size_t   remaining; /* in current slab */
+  struct ztslablarge *prev;
+  struct ztslablarge *next;
+  size_t              size; /* doubles as the block's header */
+}
+ztslablarge_t;
 
-  size_t   total_allocs;
-  size_t   current_allocs;
-  size_t   total_allocated;
+struct ztslaballoc
+{
+  void          **slablist;
+  size_t          nslablistused;
+  size_t          nslablistalloced;
+
+  size_t          slabsize;  /* of current slab */
+  size_t          remaining; /* in current slab */
+  char           *last;      /* most recent block in current slab, or NULL */
+
+  void           *freelists[SLAB_NCLASSES]; /* linked through block bodies */
+  void           *freelist;  /* freed blocks too big for a size class */
+
+  ztslablarge_t  *large;
+
+  size_t          total_allocs;
+  size_t          current_allocs;
+  size_t          total_allocated;
+  size_t          total_slabbytes;
+  size_t          inplace_reallocs;
+  size_t          reused_blocks;
+  size_t          large_allocs;
 };
 
 /* ----------------------------------------------------------------------- */
 
-ztslaballoc_t *ztslaballoc_create(void)
+ztslaballoc_t *ztslaballoc_create(size_t slabsize)
 {
   ztslaballoc_t *sa;
 
@@ -45,17 +81,30 @@ ztslaballoc_t *ztslaballoc_create(void)
   if (sa == NULL)
     return NULL;
 
+  if (slabsize == 0)
+    slabsize = ZTSLAB_DEFAULT_SIZE;
+
+  /* the first slab is allocated at this size */
+  sa->slabsize = slabsize;
+
   return sa;
 }
 
 void ztslaballoc_destroy(ztslaballoc_t *sa)
 {
-  size_t i;
+  size_t         i;
+  ztslablarge_t *large;
+  ztslablarge_t *next;
 
   if (sa == NULL)
     return;
 
-  /* FIXME: Free any non-slab allocations */
+  /* free all large blocks */
+  for (large = sa->large; large; large = next)
+  {
+    next = large->next;
+    free(large);
+  }
 
   /* free all slabs */
   for (i = 0; i < sa->nslablistused; i++)
@@ -66,52 +115,182 @@ void ztslaballoc_destroy(ztslaballoc_t *sa)
   free(sa);
 }
 
+void ztslaballoc_reset(ztslaballoc_t *sa)
+{
+  size_t         i;
+  ztslablarge_t *large;
+  ztslablarge_t *next;
+
+  for (large = sa->large; large; large = next)
+  {
+    next = large->next;
+    free(large);
+  }
+  sa->large = NULL;
+
+  /* keep only the most recent slab, which is the largest */
+  if (sa->nslablistused > 1)
+  {
+    for (i = 0; i < sa->nslablistused - 1; i++)
+      free(sa->slablist[i]);
+    sa->slablist[0]   = sa->slablist[sa->nslablistused - 1];
+    sa->nslablistused = 1;
+  }
+  sa->total_slabbytes = sa->nslablistused ? sa->slabsize : 0;
+
+  sa->remaining = sa->nslablistused ? sa->slabsize : 0;
+  sa->last      = NULL;
+
+  memset(sa->freelists, 0, sizeof(sa->freelists));
+  sa->freelist = NULL;
+
+  sa->current_allocs = 0;
+}
+
 /* ----------------------------------------------------------------------- */
 
-void *ztslaballoc(size_t n, void *opaque)
+/* Rounds 'n' up to a multiple of SLAB_ALIGN. Blocks are at least large
+ * enough to hold a free list link. */
+static size_t ztslab_round(size_t n)
 {
-  ztslaballoc_t *sa = opaque;
-  char          *p;
+  n = (n + SLAB_ALIGN - 1) & ~(size_t) (SLAB_ALIGN - 1);
+  if (n < sizeof(void *))
+    n = sizeof(void *);
+  return n;
+}
 
-  /* round block sizes up to multiple of SLAB_ALIGN */
-  n = (n + SLAB_ALIGN - 1) & ~(SLAB_ALIGN - 1);
+/* Blocks larger than a quarter of the current slab are allocated alone. */
+static int ztslab_islarge(const ztslaballoc_t *sa, size_t n)
+{
+  return n + SLAB_HEADER > sa->slabsize / 4;
+}
 
-  if (n >= SLAB_SIZE)
-    return malloc(n);
+/* Returns a previously freed block of at least 'n' bytes, or NULL. */
+static char *ztslab_reuse(ztslaballoc_t *sa, size_t n)
+{
+  void **prev;
+  char  *p;
 
-  if (sa->remaining < n)
+  if (n <= SLAB_NCLASSES * SLAB_ALIGN)
   {
-    void *newslab;
+    prev = &sa->freelists[n / SLAB_ALIGN - 1];
+    p = *prev;
+    if (p)
+    {
+      *prev = *(void **) p;
+      sa->reused_blocks++;
+      return p;
+    }
+    return NULL;
+  }
 
-    if (sa->nslablistused == sa->nslablistalloced)
+  for (prev = &sa->freelist; *prev; prev = (void **) *prev)
+  {
+    p = *prev;
+    if (SLAB_SIZEOF(p) >= n)
     {
-      size_t alloced;
-      void **newlist;
-
-      alloced = sa->nslablistalloced * 2; /* doubling strategy */
-      if (alloced <= 0)
-        alloced = 4;
-      newlist = realloc(sa->slablist, alloced * sizeof(*newlist));
-      if (newlist == NULL)
-        return NULL;
-
-      sa->slablist         = newlist;
-      sa->nslablistalloced = alloced;
+      *prev = *(void **) p;
+      sa->reused_blocks++;
+      return p;
     }
+  }
 
-    newslab = malloc(SLAB_SIZE);
-    if (newslab == NULL)
-      return NULL;
+  return NULL;
+}
+
+static char *ztslab_large_alloc(ztslaballoc_t *sa, size_t n)
+{
+  ztslablarge_t *large;
+
+  large = malloc(sizeof(*large) + n);
+  if (large == NULL)
+    return NULL;
+
+  large->prev = NULL;
+  large->next = sa->large;
+  if (sa->large)
+    sa->large->prev = large;
+  sa->large = large;
+
+  large->size = n | SLAB_LARGE;
+
+  sa->large_allocs++;
+
+  return (char *) (large + 1);
+}
+
+/* Starts a new slab, big enough for an 'n' byte block. */
+static int ztslab_grow(ztslaballoc_t *sa, size_t n)
+{
+  size_t  slabsize;
+  void   *newslab;
+
+  if (sa->nslablistused == sa->nslablistalloced)
+  {
+    size_t alloced;
+    void **newlist;
+
+    alloced = sa->nslablistalloced * 2; /* doubling strategy */
+    if (alloced <= 0)
+      alloced = 4;
+    newlist = realloc(sa->slablist, alloced * sizeof(*newlist));
+    if (newlist == NULL)
+      return 0;
+
+    sa->slablist         = newlist;
+    sa->nslablistalloced = alloced;
+  }
+
+  /* geometric growth keeps the number of slabs logarithmic in the input */
+  slabsize = sa->slabsize;
+  if (sa->nslablistused > 0 && slabsize < SLAB_MAXSIZE)
+    slabsize *= 2;
+  while (slabsize < SLAB_HEADER + n)
+    slabsize *= 2;
+
+  newslab = malloc(slabsize);
+  if (newslab == NULL)
+    return 0;
+
+  sa->slablist[sa->nslablistused++] = newslab;
+
+  sa->slabsize         = slabsize;
+  sa->remaining        = slabsize;
+  sa->last             = NULL;
+  sa->total_slabbytes += slabsize;
+
+  return 1;
+}
+
+void *ztslaballoc(size_t n, void *opaque)
+{
+  ztslaballoc_t *sa = opaque;
+  char          *p;
 
-    sa->slablist[sa->nslablistused++] = newslab;
+  n = ztslab_round(n);
 
-    sa->remaining = SLAB_SIZE;
+  if (ztslab_islarge(sa, n))
+  {
+    p = ztslab_large_alloc(sa, n);
+    if (p == NULL)
+      return NULL;
+    goto allocated;
   }
 
+  p = ztslab_reuse(sa, n);
+  if (p)
+    goto allocated;
+
+  if (sa->remaining < SLAB_HEADER + n && !ztslab_grow(sa, n))
+    return NULL;
+
   p = sa->slablist[sa->nslablistused - 1];
-  p += SLAB_SIZE - sa->remaining;
-  sa->remaining -= n;
+  p += sa->slabsize - sa->remaining + SLAB_HEADER;
+  sa->remaining -= SLAB_HEADER + n;
+  SLAB_HEADEROF(p) = n;
+  sa->last = p;
 
+allocated:
   sa->total_allocs++;
   sa->current_allocs++;
   sa->total_allocated += n;
@@ -122,12 +301,104 @@ void *ztslaballoc(size_t n, void *opaque)
 void ztslabfree(void *p, void *opaque)
 {
   ztslaballoc_t *sa = opaque;
+  size_t         n;
 
   if (p == NULL)
     return;
 
   sa->current_allocs--;
-  /* we don't free in this allocator */
+
+  n = SLAB_SIZEOF(p);
+  if (SLAB_ISLARGE(p))
+  {
+    ztslablarge_t *large = (ztslablarge_t *) p - 1;
+
+    if (large->prev)
+      large->prev->next = large->next;
+    else
+      sa->large = large->next;
+    if (large->next)
+      large->next->prev = large->prev;
+    free(large);
+  }
+  else if (p == sa->last)
+  {
+    /* the most recent block can be handed back to its slab */
+    sa->remaining += SLAB_HEADER + n;
+    sa->last = NULL;
+  }
+  else if (n <= SLAB_NCLASSES * SLAB_ALIGN)
+  {
+    *(void **) p = sa->freelists[n / SLAB_ALIGN - 1];
+    sa->freelists[n / SLAB_ALIGN - 1] = p;
+  }
+  else
+  {
+    *(void **) p = sa->freelist;
+    sa->freelist = p;
+  }
+}
+
+void *ztslabrealloc(void *p, size_t n, void *opaque)
+{
+  ztslaballoc_t *sa = opaque;
+  size_t         oldn;
+  char          *newp;
+
+  if (p == NULL)
+    return ztslaballoc(n, opaque);
+
+  n    = ztslab_round(n);
+  oldn = SLAB_SIZEOF(p);
+  if (n <= oldn)
+    return p;
+
+  if (SLAB_ISLARGE(p))
+  {
+    ztslablarge_t *large;
+
+    /* large blocks can be resized by the system allocator */
+    large = realloc((ztslablarge_t *) p - 1, sizeof(*large) + n);
+    if (large == NULL)
+      return NULL;
+
+    if (large->prev)
+      large->prev->next = large;
+    else
+      sa->large = large;
+    if (large->next)
+      large->next->prev = large;
+
+    large->size = n | SLAB_LARGE;
+    sa->total_allocated += n - oldn;
+    return large + 1;
+  }
+
+  if (p == sa->last &&
+      !ztslab_islarge(sa, n) &&
+      sa->remaining >= n - oldn)
+  {
+    /* the most recent block can be extended in place */
+    sa->remaining -= n - oldn;
+    SLAB_HEADEROF(p) = n;
+    sa->total_allocated += n - oldn;
+    sa->inplace_reallocs++;
+    return p;
+  }
+
+  newp = ztslaballoc(n, opaque);
+  if (newp == NULL)
+    return NULL;
+
+  memcpy(newp, p, oldn);
+  ztslabfree(p, opaque);
+
+  return newp;
+}
+
+void ztslabrelease(void *opaque)
+{
+  ztslaballoc_destroy(opaque);
 }
 
 /* ----------------------------------------------------------------------- */
@@ -142,8 +413,9 @@ void ztslaballoc_spew(ztslaballoc_t *sa)
   printf("- total blocks allocated=%lu\n", sa->total_allocs);
   printf("- current blocks allocated=%lu\n", sa->current_allocs);
   printf("- total bytes allocated=%lu bytes\n", sa->total_allocated);
-  printf("- number of slabs=%lu used (of %lu) @ %d each = %lu total bytes\n", sa->nslablistused, sa->nslablistalloced, SLAB_SIZE, sa->nslablistused * SLAB_SIZE);
+  printf("- number of slabs=%lu used (of %lu), last @ %lu = %lu total bytes\n", sa->nslablistused, sa->nslablistalloced, sa->slabsize, sa->total_slabbytes);
   printf("- average allocation size=%.2f\n", (double) sa->total_allocated / sa->total_allocs);
+  printf("- in-place reallocs=%lu, reused blocks=%lu, large blocks=%lu\n", sa->inplace_reallocs, sa->reused_blocks, sa->large_allocs);
 }
 #endif
 
@@ -6,18 +6,37 @@
 #ifndef ZT_SLAB_ALLOC_H
 #define ZT_SLAB_ALLOC_H
 
+#include <stddef.h>
+
 /* ----------------------------------------------------------------------- */
 
 typedef struct ztslaballoc ztslaballoc_t;
 
+/* Size of the first slab. Each subsequent slab is twice the size of its
+ * predecessor, up to a limit. */
+#define ZTSLAB_DEFAULT_SIZE (4000)
+
 /* ----------------------------------------------------------------------- */
 
-ztslaballoc_t *ztslaballoc_create(void);
+/* Pass zero for 'slabsize' to use the default. */
+ztslaballoc_t *ztslaballoc_create(size_t slabsize);
+
+/* Frees every block, including any which were never freed. */
 void ztslaballoc_destroy(ztslaballoc_t *sa);
 
+/* Frees every block at once, keeping the largest slab for reuse. */
+void ztslaballoc_reset(ztslaballoc_t *sa);
+
 void *ztslaballoc(size_t n, void *opaque);
 void ztslabfree(void *p, void *opaque);
 
+/* Extends the most recent allocation in place where possible, otherwise
+ * moves the block, reusing a freed one if a large enough one exists. */
+void *ztslabrealloc(void *p, size_t n, void *opaque);
+
+/* As ztslaballoc_destroy, for use as a ztast_releasefn_t. */
+void ztslabrelease(void *opaque);
+
 #ifdef ZT_DEBUG
 void ztslaballoc_spew(ztslaballoc_t *sa);
 #endif
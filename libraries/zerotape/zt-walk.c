@@ -9,14 +9,17 @@
 
 #include "zerotape/zerotape.h"
 
+#include "zt-region.h"
+
 #include "zt-walk.h"
 
-ztresult_t zt_walk(const ztstruct_t       *metastruct,
-                   const void             *structure,
-                   const ztregion_t       *regions,
-                   int                     nregions,
-                   const ztwalkhandlers_t *walkhandlers,
-                   void                   *opaque)
+/* ----------------------------------------------------------------------- */
+
+static ztresult_t zt_walk_struct(const ztstruct_t       *metastruct,
+                                 const void             *structure,
+                                 const ztregiontable_t  *regions,
+                                 const ztwalkhandlers_t *walkhandlers,
+                                 void                   *opaque)
 {
   int              rc;
   const ztfield_t *f;
@@ -95,12 +98,11 @@ ztresult_t zt_walk(const ztstruct_t       *metastruct,
           if (rc)
             return rc;
 
-          rc = zt_walk(f->metadata,
-                       pstruct,
-                       regions,
-                       nregions,
-                       walkhandlers,
-                       opaque);
+          rc = zt_walk_struct(f->metadata,
+                              pstruct,
+                              regions,
+                              walkhandlers,
+                              opaque);
           if (rc)
             return rc;
 
@@ -122,12 +124,11 @@ ztresult_t zt_walk(const ztstruct_t       *metastruct,
             if (rc)
               return rc;
 
-            rc = zt_walk(f->metadata,
-                         (char *) pstruct + i * f->size,
-                         regions,
-                         nregions,
-                         walkhandlers,
-                         opaque);
+            rc = zt_walk_struct(f->metadata,
+                                (char *) pstruct + i * f->size,
+                                regions,
+                                walkhandlers,
+                                opaque);
             if (rc)
               return rc;
 
@@ -153,12 +154,11 @@ ztresult_t zt_walk(const ztstruct_t       *metastruct,
           if (rc)
             return rc;
 
-          rc = zt_walk(f->metadata,
-                       *ppstruct,
-                       regions,
-                       nregions,
-                       walkhandlers,
-                       opaque);
+          rc = zt_walk_struct(f->metadata,
+                              *ppstruct,
+                              regions,
+                              walkhandlers,
+                              opaque);
           if (rc)
             return rc;
 
@@ -180,12 +180,11 @@ ztresult_t zt_walk(const ztstruct_t       *metastruct,
             if (rc)
               return rc;
 
-            rc = zt_walk(f->metadata,
-                         *ppstruct++,
-                         regions,
-                         nregions,
-                         walkhandlers,
-                         opaque);
+            rc = zt_walk_struct(f->metadata,
+                                *ppstruct++,
+                                regions,
+                                walkhandlers,
+                                opaque);
             if (rc)
               return rc;
 
@@ -239,7 +238,6 @@ ztresult_t zt_walk(const ztstruct_t       *metastruct,
 
     case zttype_arrayidx:
       {
-        int                   r;
         const ztarray_t      *array;
         const char           *base;
         const char           *end;
@@ -250,16 +248,11 @@ ztresult_t zt_walk(const ztstruct_t       *metastruct,
         if (f->nelems != 1)
           return ztresult_BAD_FIELD;
 
-        /* find f->regionid in regions[] */
-        for (r = 0; r < nregions; r++)
-          if (regions[r].id == f->regionid)
-            break;
-
-        if (r == nregions)
+        array = zt_regiontable_find(regions, f->regionid);
+        if (array == NULL)
           return ztresult_UNKNOWN_REGION;
 
         /* use the array spec to turn it into an index */
-        array = &regions[r].spec;
         base  = array->base;
         end   = (const char *) array->base + array->length;
         pp    = (const unsigned char **) rawvalue;
@@ -309,6 +302,23 @@ ztresult_t zt_walk(const ztstruct_t       *metastruct,
   return ztresult_OK;
 }
 
+ztresult_t zt_walk(const ztstruct_t       *metastruct,
+                   const void             *structure,
+                   const ztregion_t       *regions,
+                   int                     nregions,
+                   const ztwalkhandlers_t *walkhandlers,
+                   void                   *opaque)
+{
+  ztresult_t      rc;
+  ztregiontable_t table;
+
+  zt_regiontable_init(&table, regions, nregions);
+  rc = zt_walk_struct(metastruct, structure, &table, walkhandlers, opaque);
+  zt_regiontable_fini(&table);
+
+  return rc;
+}
+
 /* ----------------------------------------------------------------------- */
 
 /* vim: set ts=8 sts=2 sw=2 et: */